@@ -0,0 +1,325 @@
+#include "allocator.hpp"
+
+#include <format>
+#include <utility>
+
+namespace compound {
+const char* toString(MemoryCategory category) noexcept {
+    switch (category) {
+        case MemoryCategory::eAttachment:
+            return "attachments";
+        case MemoryCategory::eMesh:
+            return "meshes";
+        case MemoryCategory::eTexture:
+            return "textures";
+        case MemoryCategory::eStaging:
+            return "staging";
+        case MemoryCategory::eUniform:
+            return "uniforms";
+        case MemoryCategory::eQuery:
+            return "queries";
+    }
+    return "unknown";
+}
+
+Buffer::Buffer(Buffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_allocator = std::exchange(other.m_allocator, nullptr);
+        m_buffer = std::exchange(other.m_buffer, VK_NULL_HANDLE);
+        m_allocation = std::exchange(other.m_allocation, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_allocationSize = std::exchange(other.m_allocationSize, 0);
+        m_mappedData = std::exchange(other.m_mappedData, nullptr);
+        m_category = other.m_category;
+        m_usage = other.m_usage;
+        if (m_allocator) {
+            m_allocator->setOwner(m_allocation, this);
+        }
+    }
+    return *this;
+}
+
+Buffer::~Buffer() {
+    release();
+}
+
+void Buffer::release() noexcept {
+    if (m_allocator == nullptr) {
+        return;
+    }
+    m_allocator->destroy(m_buffer, m_allocation);
+    m_allocator->track(m_category, m_allocationSize, false);
+    m_allocator = nullptr;
+}
+
+vk::Buffer Buffer::getBuffer() const noexcept {
+    return m_buffer;
+}
+
+VmaAllocation Buffer::getAllocation() const noexcept {
+    return m_allocation;
+}
+
+vk::DeviceSize Buffer::getSize() const noexcept {
+    return m_size;
+}
+
+void* Buffer::getMappedData() const noexcept {
+    return m_mappedData;
+}
+
+MemoryCategory Buffer::getCategory() const noexcept {
+    return m_category;
+}
+
+vk::BufferUsageFlags Buffer::getUsage() const noexcept {
+    return m_usage;
+}
+
+Image::Image(Image&& other) noexcept {
+    *this = std::move(other);
+}
+
+Image& Image::operator=(Image&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_allocator = std::exchange(other.m_allocator, nullptr);
+        m_image = std::exchange(other.m_image, VK_NULL_HANDLE);
+        m_allocation = std::exchange(other.m_allocation, nullptr);
+        m_format = other.m_format;
+        m_extent = other.m_extent;
+        m_mipLevels = other.m_mipLevels;
+        m_createInfo = other.m_createInfo;
+        m_allocationSize = std::exchange(other.m_allocationSize, 0);
+        m_category = other.m_category;
+        if (m_allocator) {
+            m_allocator->setOwner(m_allocation, this);
+        }
+    }
+    return *this;
+}
+
+Image::~Image() {
+    release();
+}
+
+void Image::release() noexcept {
+    if (m_allocator == nullptr) {
+        return;
+    }
+    m_allocator->destroy(m_image, m_allocation);
+    m_allocator->track(m_category, m_allocationSize, false);
+    m_allocator = nullptr;
+}
+
+vk::Image Image::getImage() const noexcept {
+    return m_image;
+}
+
+VmaAllocation Image::getAllocation() const noexcept {
+    return m_allocation;
+}
+
+vk::Format Image::getFormat() const noexcept {
+    return m_format;
+}
+
+const vk::Extent3D& Image::getExtent() const noexcept {
+    return m_extent;
+}
+
+uint32_t Image::getMipLevels() const noexcept {
+    return m_mipLevels;
+}
+
+MemoryCategory Image::getCategory() const noexcept {
+    return m_category;
+}
+
+Allocator::Allocator(const Init& init, const Device& device) {
+    LOG4CPLUS_INFO(m_logger, "Creating allocator");
+    VmaAllocatorCreateInfo createInfo{};
+    createInfo.instance = *init.getVkInstance();
+    createInfo.physicalDevice = *device.getPhysicalDevice();
+    createInfo.device = *device.getDevice();
+    m_device = *device.getDevice();
+    createInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+    if (device.isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        createInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    } else {
+        LOG4CPLUS_WARN(m_logger, "Memory budget extension unavailable, "
+                                 "budgets are estimated");
+    }
+    if (vmaCreateAllocator(&createInfo, &m_allocator) != VK_SUCCESS) {
+        LOG4CPLUS_ERROR(m_logger, "Failed to create allocator");
+        throw std::runtime_error("Failed to create allocator");
+    }
+}
+
+Allocator::~Allocator() {
+    vmaDestroyAllocator(m_allocator);
+}
+
+Buffer Allocator::createBuffer(
+    const vk::BufferCreateInfo& createInfo,
+    const VmaAllocationCreateInfo& allocationCreateInfo,
+    MemoryCategory category) {
+    Buffer buffer;
+    VmaAllocationInfo allocationInfo{};
+    VkBufferCreateInfo bufferCreateInfo = createInfo;
+    if (vmaCreateBuffer(m_allocator, &bufferCreateInfo, &allocationCreateInfo,
+                        &buffer.m_buffer, &buffer.m_allocation,
+                        &allocationInfo) != VK_SUCCESS) {
+        LOG4CPLUS_ERROR(m_logger,
+                        std::format("Failed to allocate {} bytes of {}",
+                                    createInfo.size, toString(category)));
+        throw std::runtime_error("Failed to allocate buffer");
+    }
+    buffer.m_allocator = this;
+    buffer.m_size = createInfo.size;
+    buffer.m_allocationSize = allocationInfo.size;
+    buffer.m_mappedData = allocationInfo.pMappedData;
+    buffer.m_category = category;
+    buffer.m_usage = createInfo.usage;
+    setOwner(buffer.m_allocation, &buffer);
+    track(category, allocationInfo.size, true);
+    return buffer;
+}
+
+Image Allocator::createImage(
+    const vk::ImageCreateInfo& createInfo,
+    const VmaAllocationCreateInfo& allocationCreateInfo,
+    MemoryCategory category) {
+    Image image;
+    VmaAllocationInfo allocationInfo{};
+    VkImageCreateInfo imageCreateInfo = createInfo;
+    if (vmaCreateImage(m_allocator, &imageCreateInfo, &allocationCreateInfo,
+                       &image.m_image, &image.m_allocation,
+                       &allocationInfo) != VK_SUCCESS) {
+        LOG4CPLUS_ERROR(m_logger, std::format("Failed to allocate image for {}",
+                                              toString(category)));
+        throw std::runtime_error("Failed to allocate image");
+    }
+    image.m_allocator = this;
+    image.m_format = createInfo.format;
+    image.m_extent = createInfo.extent;
+    image.m_mipLevels = createInfo.mipLevels;
+    image.m_allocationSize = allocationInfo.size;
+    image.m_category = category;
+    image.m_createInfo = createInfo;
+    image.m_createInfo.setPNext(nullptr);
+    image.m_createInfo.queueFamilyIndexCount = 0;
+    image.m_createInfo.pQueueFamilyIndices = nullptr;
+    image.m_createInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+    setOwner(image.m_allocation, &image);
+    track(category, allocationInfo.size, true);
+    return image;
+}
+
+void Allocator::track(MemoryCategory category, vk::DeviceSize size,
+                      bool allocated) noexcept {
+    auto& usage = m_categoryUsage[static_cast<size_t>(category)];
+    if (allocated) {
+        usage.fetch_add(size, std::memory_order_relaxed);
+    } else {
+        usage.fetch_sub(size, std::memory_order_relaxed);
+    }
+}
+
+void Allocator::setOwner(VmaAllocation allocation, Owner owner) {
+    std::lock_guard lock(m_ownerMutex);
+    m_owners.insert_or_assign(allocation, owner);
+}
+
+bool Allocator::abandon(VmaAllocation allocation) noexcept {
+    std::lock_guard lock(m_ownerMutex);
+    m_owners.erase(allocation);
+    if (!m_moving.contains(allocation)) {
+        return false;
+    }
+    m_abandoned.insert(allocation);
+    return true;
+}
+
+void Allocator::destroy(VkBuffer buffer, VmaAllocation allocation) noexcept {
+    if (abandon(allocation)) {
+        vkDestroyBuffer(m_device, buffer, nullptr);
+    } else {
+        vmaDestroyBuffer(m_allocator, buffer, allocation);
+    }
+}
+
+void Allocator::destroy(VkImage image, VmaAllocation allocation) noexcept {
+    if (abandon(allocation)) {
+        vkDestroyImage(m_device, image, nullptr);
+    } else {
+        vmaDestroyImage(m_allocator, image, allocation);
+    }
+}
+
+VmaAllocator Allocator::getAllocator() const noexcept {
+    return m_allocator;
+}
+
+vk::DeviceSize Allocator::getCategoryUsage(
+    MemoryCategory category) const noexcept {
+    return m_categoryUsage[static_cast<size_t>(category)].load(
+        std::memory_order_relaxed);
+}
+
+std::vector<Allocator::HeapBudget> Allocator::getHeapBudgets() const {
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(m_allocator, &memoryProperties);
+    std::vector<VmaBudget> budgets(memoryProperties->memoryHeapCount);
+    vmaGetHeapBudgets(m_allocator, budgets.data());
+    std::vector<HeapBudget> heapBudgets;
+    for (uint32_t i = 0; i < budgets.size(); i++) {
+        heapBudgets.push_back({i, budgets[i].usage, budgets[i].budget});
+    }
+    return heapBudgets;
+}
+
+void Allocator::addBudgetCallback(float threshold, BudgetCallback callback) {
+    std::lock_guard lock(m_budgetMutex);
+    m_budgetWatches.push_back({threshold, std::move(callback), {}});
+}
+
+void Allocator::checkBudget(uint64_t frame) {
+    // A new frame index makes VMA refresh its cached budget.
+    vmaSetCurrentFrameIndex(m_allocator, static_cast<uint32_t>(frame));
+    auto heapBudgets = getHeapBudgets();
+    struct Crossing {
+        BudgetCallback callback;
+        HeapBudget budget;
+        bool exceeded;
+    };
+    std::vector<Crossing> crossings;
+    {
+        std::lock_guard lock(m_budgetMutex);
+        for (auto& watch : m_budgetWatches) {
+            watch.exceeded.resize(heapBudgets.size(), false);
+            for (const auto& heapBudget : heapBudgets) {
+                if (heapBudget.budget == 0) {
+                    continue;
+                }
+                bool exceeded = static_cast<float>(heapBudget.usage) >
+                                watch.threshold *
+                                    static_cast<float>(heapBudget.budget);
+                if (exceeded != watch.exceeded[heapBudget.heap]) {
+                    watch.exceeded[heapBudget.heap] = exceeded;
+                    crossings.push_back({watch.callback, heapBudget, exceeded});
+                }
+            }
+        }
+    }
+    // Called without the lock, so that callbacks may add callbacks.
+    for (const auto& crossing : crossings) {
+        crossing.callback(crossing.budget, crossing.exceeded);
+    }
+}
+} // namespace compound
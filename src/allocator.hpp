@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+#include "init.hpp"
+#include "device.hpp"
+#include <log4cplus/log4cplus.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace compound {
+enum class MemoryCategory : uint32_t {
+    eAttachment,
+    eMesh,
+    eTexture,
+    eStaging,
+    eUniform,
+    // Query results and predicates written by the GPU.
+    eQuery,
+};
+inline constexpr size_t kMemoryCategoryCount = 6;
+const char* toString(MemoryCategory category) noexcept;
+
+class Allocator;
+class Defragmenter;
+
+class Buffer {
+public:
+    Buffer() = default;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(Buffer&& other) noexcept;
+    ~Buffer();
+    vk::Buffer getBuffer() const noexcept;
+    VmaAllocation getAllocation() const noexcept;
+    vk::DeviceSize getSize() const noexcept;
+    void* getMappedData() const noexcept;
+    MemoryCategory getCategory() const noexcept;
+    vk::BufferUsageFlags getUsage() const noexcept;
+
+private:
+    friend class Allocator;
+    friend class Defragmenter;
+    Allocator* m_allocator = nullptr;
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    VmaAllocation m_allocation = nullptr;
+    vk::DeviceSize m_size = 0;
+    vk::DeviceSize m_allocationSize = 0;
+    void* m_mappedData = nullptr;
+    MemoryCategory m_category = MemoryCategory::eMesh;
+    // Kept to recreate the buffer elsewhere.
+    vk::BufferUsageFlags m_usage{};
+    void release() noexcept;
+};
+
+class Image {
+public:
+    Image() = default;
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image&& other) noexcept;
+    Image& operator=(Image&& other) noexcept;
+    ~Image();
+    vk::Image getImage() const noexcept;
+    VmaAllocation getAllocation() const noexcept;
+    vk::Format getFormat() const noexcept;
+    const vk::Extent3D& getExtent() const noexcept;
+    uint32_t getMipLevels() const noexcept;
+    MemoryCategory getCategory() const noexcept;
+
+private:
+    friend class Allocator;
+    friend class Defragmenter;
+    Allocator* m_allocator = nullptr;
+    VkImage m_image = VK_NULL_HANDLE;
+    VmaAllocation m_allocation = nullptr;
+    vk::Format m_format = vk::Format::eUndefined;
+    vk::Extent3D m_extent;
+    uint32_t m_mipLevels = 0;
+    // Kept to recreate the image elsewhere, without pNext or queue families.
+    vk::ImageCreateInfo m_createInfo;
+    vk::DeviceSize m_allocationSize = 0;
+    MemoryCategory m_category = MemoryCategory::eTexture;
+    void release() noexcept;
+};
+
+// VMA allocator that tags every allocation with a category and watches heap
+// usage against the budget reported by VK_EXT_memory_budget when enabled.
+class Allocator {
+public:
+    struct HeapBudget {
+        uint32_t heap;
+        vk::DeviceSize usage;
+        vk::DeviceSize budget;
+    };
+    using BudgetCallback =
+        std::function<void(const HeapBudget& budget, bool exceeded)>;
+
+    Allocator(const Init& init, const Device& device);
+    Allocator(const Allocator&) = delete;
+    Allocator& operator=(const Allocator&) = delete;
+    ~Allocator();
+    Buffer createBuffer(const vk::BufferCreateInfo& createInfo,
+                        const VmaAllocationCreateInfo& allocationCreateInfo,
+                        MemoryCategory category);
+    Image createImage(const vk::ImageCreateInfo& createInfo,
+                      const VmaAllocationCreateInfo& allocationCreateInfo,
+                      MemoryCategory category);
+    VmaAllocator getAllocator() const noexcept;
+    vk::DeviceSize getCategoryUsage(MemoryCategory category) const noexcept;
+    std::vector<HeapBudget> getHeapBudgets() const;
+    // The callback is invoked by checkBudget() each time a heap's usage
+    // crosses the threshold fraction of its budget, in either direction.
+    void addBudgetCallback(float threshold, BudgetCallback callback);
+    void checkBudget(uint64_t frame);
+
+private:
+    struct BudgetWatch {
+        float threshold;
+        BudgetCallback callback;
+        std::vector<bool> exceeded;
+    };
+    using Owner = std::variant<Buffer*, Image*>;
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.allocator");
+    VmaAllocator m_allocator = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+    // Which object holds each allocation, so that a defragmentation pass can
+    // rewrite its handle. Allocations being moved by the running pass only
+    // lose their resource when destroyed; the pass frees their memory.
+    std::mutex m_ownerMutex;
+    std::unordered_map<VmaAllocation, Owner> m_owners;
+    std::set<VmaAllocation> m_moving;
+    std::set<VmaAllocation> m_abandoned;
+    std::array<std::atomic<vk::DeviceSize>, kMemoryCategoryCount>
+        m_categoryUsage{};
+    std::mutex m_budgetMutex;
+    std::vector<BudgetWatch> m_budgetWatches;
+    void track(MemoryCategory category, vk::DeviceSize size,
+               bool allocated) noexcept;
+    void setOwner(VmaAllocation allocation, Owner owner);
+    void destroy(VkBuffer buffer, VmaAllocation allocation) noexcept;
+    void destroy(VkImage image, VmaAllocation allocation) noexcept;
+    bool abandon(VmaAllocation allocation) noexcept;
+    friend class Buffer;
+    friend class Image;
+    friend class Defragmenter;
+};
+} // namespace compound
@@ -0,0 +1,274 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <string>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace compound {
+namespace {
+Aabb merge(const Aabb& a, const Aabb& b) noexcept {
+    return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+// Returns a 4-bit mask of the children outside the frustum and, through
+// inside, the mask of those entirely within it.
+uint32_t classify(const std::array<float, 4>& minX,
+                  const std::array<float, 4>& minY,
+                  const std::array<float, 4>& minZ,
+                  const std::array<float, 4>& maxX,
+                  const std::array<float, 4>& maxY,
+                  const std::array<float, 4>& maxZ, const Frustum& frustum,
+                  uint32_t& inside) noexcept {
+#if defined(__SSE2__)
+    __m128 loX = _mm_load_ps(minX.data());
+    __m128 loY = _mm_load_ps(minY.data());
+    __m128 loZ = _mm_load_ps(minZ.data());
+    __m128 hiX = _mm_load_ps(maxX.data());
+    __m128 hiY = _mm_load_ps(maxY.data());
+    __m128 hiZ = _mm_load_ps(maxZ.data());
+    __m128 outside = _mm_setzero_ps();
+    __m128 partial = _mm_setzero_ps();
+    for (const auto& plane : frustum.planes) {
+        // The corner furthest along the plane normal decides whether a box
+        // is outside, the nearest one whether it is entirely inside.
+        __m128 px = _mm_set1_ps(plane.x);
+        __m128 py = _mm_set1_ps(plane.y);
+        __m128 pz = _mm_set1_ps(plane.z);
+        __m128 pw = _mm_set1_ps(plane.w);
+        bool sx = plane.x > 0.0f;
+        bool sy = plane.y > 0.0f;
+        bool sz = plane.z > 0.0f;
+        __m128 farthest = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(sx ? hiX : loX, px),
+                       _mm_mul_ps(sy ? hiY : loY, py)),
+            _mm_add_ps(_mm_mul_ps(sz ? hiZ : loZ, pz), pw));
+        __m128 nearest = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(sx ? loX : hiX, px),
+                       _mm_mul_ps(sy ? loY : hiY, py)),
+            _mm_add_ps(_mm_mul_ps(sz ? loZ : hiZ, pz), pw));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(farthest, _mm_setzero_ps()));
+        partial = _mm_or_ps(partial, _mm_cmplt_ps(nearest, _mm_setzero_ps()));
+    }
+    uint32_t outsideMask = _mm_movemask_ps(outside);
+    inside = ~(_mm_movemask_ps(partial) | outsideMask) & 0xfu;
+    return outsideMask;
+#else
+    uint32_t outsideMask = 0;
+    uint32_t partialMask = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        for (const auto& plane : frustum.planes) {
+            float farthest = plane.w +
+                        plane.x * (plane.x > 0.0f ? maxX[i] : minX[i]) +
+                        plane.y * (plane.y > 0.0f ? maxY[i] : minY[i]) +
+                        plane.z * (plane.z > 0.0f ? maxZ[i] : minZ[i]);
+            float nearest = plane.w +
+                         plane.x * (plane.x > 0.0f ? minX[i] : maxX[i]) +
+                         plane.y * (plane.y > 0.0f ? minY[i] : maxY[i]) +
+                         plane.z * (plane.z > 0.0f ? minZ[i] : maxZ[i]);
+            outsideMask |= (farthest < 0.0f ? 1u : 0u) << i;
+            partialMask |= (nearest < 0.0f ? 1u : 0u) << i;
+        }
+    }
+    inside = ~(partialMask | outsideMask) & 0xfu;
+    return outsideMask;
+#endif
+}
+} // namespace
+
+Aabb Aabb::fromSphere(const glm::vec3& center, float radius) noexcept {
+    return {center - glm::vec3(radius), center + glm::vec3(radius)};
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& m) noexcept {
+    auto row = [&](int i) {
+        return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    };
+    Frustum frustum{{row(3) + row(0), row(3) - row(0), row(3) + row(1),
+                     row(3) - row(1), row(2), row(3) - row(2)}};
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void Bvh::build(std::span<const Aabb> bounds) {
+    LOG4CPLUS_INFO(m_logger, "Building bvh over " +
+                                 std::to_string(bounds.size()) + " objects");
+    m_nodes.clear();
+    m_nodeParents.clear();
+    m_objectSlots.assign(bounds.size(), {kEmpty, 0});
+    std::vector<uint32_t> objects(bounds.size());
+    std::iota(objects.begin(), objects.end(), 0u);
+    m_root = objects.empty() ? kEmpty : build(bounds, objects);
+    m_dirty.assign(m_nodes.size(), 0);
+    m_needsRefit = false;
+}
+
+uint32_t Bvh::build(std::span<const Aabb> bounds,
+                    std::span<uint32_t> objects) {
+    if (objects.size() == 1) {
+        return kLeaf | objects[0];
+    }
+    uint32_t index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    m_nodeParents.push_back({kEmpty, 0});
+    // Median split along the longest axis of the centroids, into four groups.
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
+    for (uint32_t object : objects) {
+        glm::vec3 center = (bounds[object].min + bounds[object].max) * 0.5f;
+        lo = glm::min(lo, center);
+        hi = glm::max(hi, center);
+    }
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                   : (extent.y > extent.z ? 1 : 2);
+    std::sort(objects.begin(), objects.end(), [&](uint32_t a, uint32_t b) {
+        return bounds[a].min[axis] + bounds[a].max[axis] <
+               bounds[b].min[axis] + bounds[b].max[axis];
+    });
+    size_t groups = std::min<size_t>(objects.size(), 4);
+    for (uint32_t slot = 0; slot < 4; slot++) {
+        Slot location{index, slot};
+        if (slot >= groups) {
+            m_nodes[index].children[slot] = kEmpty;
+            setSlot(location, {glm::vec3(0.0f), glm::vec3(0.0f)});
+            continue;
+        }
+        auto group = objects.subspan(objects.size() * slot / groups,
+                                     objects.size() * (slot + 1) / groups -
+                                         objects.size() * slot / groups);
+        Aabb box = bounds[group[0]];
+        for (uint32_t object : group) {
+            box = merge(box, bounds[object]);
+        }
+        uint32_t child = build(bounds, group);
+        if ((child & kLeaf) != 0) {
+            m_objectSlots[child & ~kLeaf] = location;
+        } else {
+            m_nodeParents[child] = location;
+        }
+        // Children are appended after their parent, so index stays valid.
+        m_nodes[index].children[slot] = child;
+        setSlot(location, box);
+    }
+    return index;
+}
+
+void Bvh::setSlot(const Slot& slot, const Aabb& bounds) noexcept {
+    Node& node = m_nodes[slot.node];
+    node.minX[slot.slot] = bounds.min.x;
+    node.minY[slot.slot] = bounds.min.y;
+    node.minZ[slot.slot] = bounds.min.z;
+    node.maxX[slot.slot] = bounds.max.x;
+    node.maxY[slot.slot] = bounds.max.y;
+    node.maxZ[slot.slot] = bounds.max.z;
+}
+
+void Bvh::update(ObjectId object, const Aabb& bounds) {
+    const Slot& slot = m_objectSlots[object];
+    if (slot.node == kEmpty) {
+        // A lone object has no node to store its bounds in.
+        return;
+    }
+    setSlot(slot, bounds);
+    m_dirty[slot.node] = 1;
+    m_needsRefit = true;
+}
+
+void Bvh::refit() {
+    if (!m_needsRefit) {
+        return;
+    }
+    // Children always have higher indices than their parent, so a reverse
+    // sweep sees every node after all of its children.
+    for (size_t i = m_nodes.size(); i-- > 1;) {
+        if (m_dirty[i] == 0) {
+            continue;
+        }
+        m_dirty[i] = 0;
+        const Node& node = m_nodes[i];
+        Aabb box{glm::vec3(std::numeric_limits<float>::max()),
+                 glm::vec3(std::numeric_limits<float>::lowest())};
+        for (uint32_t slot = 0; slot < 4; slot++) {
+            if (node.children[slot] == kEmpty) {
+                continue;
+            }
+            box = merge(box, {{node.minX[slot], node.minY[slot],
+                               node.minZ[slot]},
+                              {node.maxX[slot], node.maxY[slot],
+                               node.maxZ[slot]}});
+        }
+        setSlot(m_nodeParents[i], box);
+        m_dirty[m_nodeParents[i].node] = 1;
+    }
+    if (!m_dirty.empty()) {
+        m_dirty[0] = 0;
+    }
+    m_needsRefit = false;
+}
+
+void Bvh::collect(uint32_t child, std::vector<ObjectId>& visible) {
+    if ((child & kLeaf) != 0) {
+        visible.push_back(child & ~kLeaf);
+        return;
+    }
+    m_statistics.nodesVisited++;
+    for (uint32_t grandchild : m_nodes[child].children) {
+        if (grandchild != kEmpty) {
+            collect(grandchild, visible);
+        }
+    }
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<ObjectId>& visible) {
+    refit();
+    visible.clear();
+    m_statistics = {};
+    if (m_root == kEmpty) {
+        return;
+    }
+    if ((m_root & kLeaf) != 0) {
+        // Without a node there is no stored bounds to test against.
+        visible.push_back(m_root & ~kLeaf);
+    } else {
+        m_stack.assign(1, m_root);
+        while (!m_stack.empty()) {
+            const Node& node = m_nodes[m_stack.back()];
+            m_stack.pop_back();
+            m_statistics.nodesVisited++;
+            uint32_t inside = 0;
+            uint32_t outside =
+                classify(node.minX, node.minY, node.minZ, node.maxX, node.maxY,
+                         node.maxZ, frustum, inside);
+            for (uint32_t slot = 0; slot < 4; slot++) {
+                uint32_t child = node.children[slot];
+                if (child == kEmpty || (outside & (1u << slot)) != 0) {
+                    continue;
+                }
+                if ((inside & (1u << slot)) != 0) {
+                    collect(child, visible);
+                } else if ((child & kLeaf) != 0) {
+                    visible.push_back(child & ~kLeaf);
+                } else {
+                    m_stack.push_back(child);
+                }
+            }
+        }
+    }
+    m_statistics.objectsVisible = visible.size();
+    m_statistics.objectsCulled = m_objectSlots.size() - visible.size();
+}
+
+size_t Bvh::getObjectCount() const noexcept {
+    return m_objectSlots.size();
+}
+
+const Bvh::Statistics& Bvh::getStatistics() const noexcept {
+    return m_statistics;
+}
+} // namespace compound
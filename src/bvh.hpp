@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <log4cplus/log4cplus.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace compound {
+struct Aabb {
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+    static Aabb fromSphere(const glm::vec3& center, float radius) noexcept;
+};
+
+// Six normalized planes facing inwards, extracted from a view projection
+// matrix with Vulkan's [0, 1] depth range.
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+    static Frustum fromMatrix(const glm::mat4& viewProjection) noexcept;
+};
+
+// Four-wide bounding volume hierarchy over object bounds, culled against a
+// frustum four children at a time with SSE. Subtrees entirely inside the
+// frustum are accepted without further plane tests. Moving an object only
+// refits the boxes on its path to the root, the tree is not rebuilt.
+class Bvh {
+public:
+    using ObjectId = uint32_t;
+    struct Statistics {
+        size_t nodesVisited = 0;
+        size_t objectsVisible = 0;
+        size_t objectsCulled = 0;
+    };
+
+    // Object ids are indices into bounds.
+    void build(std::span<const Aabb> bounds);
+    void update(ObjectId object, const Aabb& bounds);
+    void refit();
+    // Replaces the contents of visible with the ids of the objects whose
+    // bounds intersect the frustum.
+    void cull(const Frustum& frustum, std::vector<ObjectId>& visible);
+    size_t getObjectCount() const noexcept;
+    const Statistics& getStatistics() const noexcept;
+
+private:
+    static constexpr uint32_t kLeaf = 0x80000000u;
+    static constexpr uint32_t kEmpty = 0xffffffffu;
+    struct alignas(16) Node {
+        std::array<float, 4> minX, minY, minZ;
+        std::array<float, 4> maxX, maxY, maxZ;
+        std::array<uint32_t, 4> children;
+    };
+    struct Slot {
+        uint32_t node;
+        uint32_t slot;
+    };
+    log4cplus::Logger m_logger = log4cplus::Logger::getInstance("compound.bvh");
+    std::vector<Node> m_nodes;
+    // Where each node and each object is referenced from.
+    std::vector<Slot> m_nodeParents;
+    std::vector<Slot> m_objectSlots;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint32_t> m_stack;
+    bool m_needsRefit = false;
+    // Either node 0, a single leaf or empty.
+    uint32_t m_root = kEmpty;
+    Statistics m_statistics;
+    uint32_t build(std::span<const Aabb> bounds, std::span<uint32_t> objects);
+    void setSlot(const Slot& slot, const Aabb& bounds) noexcept;
+    void collect(uint32_t child, std::vector<ObjectId>& visible);
+};
+} // namespace compound
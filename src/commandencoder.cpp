@@ -0,0 +1,216 @@
+#include "commandencoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace compound {
+CommandEncoder::CommandEncoder(const vk::raii::CommandBuffer& buffer)
+    : m_buffer(buffer) {
+}
+
+template <typename T>
+bool CommandEncoder::elide(std::optional<T>& tracked, const T& value) noexcept {
+    if (tracked.has_value() && tracked.value() == value) {
+        m_statistics.elided++;
+        return true;
+    }
+    tracked = value;
+    m_statistics.issued++;
+    return false;
+}
+
+CommandEncoder::BindPointState& CommandEncoder::getBindPointState(
+    vk::PipelineBindPoint bindPoint) {
+    if (bindPoint == vk::PipelineBindPoint::eCompute) {
+        return m_compute;
+    }
+    return m_graphics;
+}
+
+void CommandEncoder::bindPipeline(vk::PipelineBindPoint bindPoint,
+                                  vk::Pipeline pipeline) {
+    auto& state = getBindPointState(bindPoint);
+    if (state.pipeline == pipeline) {
+        m_statistics.elided++;
+        return;
+    }
+    state.pipeline = pipeline;
+    m_statistics.issued++;
+    m_statistics.pipelineBinds++;
+    m_buffer.bindPipeline(bindPoint, pipeline);
+}
+
+void CommandEncoder::bindDescriptorSets(
+    vk::PipelineBindPoint bindPoint, vk::PipelineLayout layout,
+    uint32_t firstSet, vk::ArrayProxy<const vk::DescriptorSet> sets,
+    vk::ArrayProxy<const uint32_t> dynamicOffsets) {
+    auto& state = getBindPointState(bindPoint);
+    std::vector<uint32_t> offsets(dynamicOffsets.begin(), dynamicOffsets.end());
+    // Dynamic offsets cannot be split per set without the set layouts, so
+    // only single-set binds carrying offsets are tracked.
+    bool trackable = offsets.empty() || sets.size() == 1;
+    uint32_t lastSet = firstSet + sets.size();
+    bool redundant = trackable && lastSet <= kMaxDescriptorSets;
+    for (uint32_t i = firstSet; i < lastSet && redundant; i++) {
+        const auto& bound = state.descriptorSets[i];
+        redundant = bound.has_value() && bound->layout == layout &&
+                    bound->set == sets.data()[i - firstSet] &&
+                    bound->dynamicOffsets == offsets;
+    }
+    if (redundant) {
+        m_statistics.elided++;
+        return;
+    }
+    m_statistics.issued++;
+    m_buffer.bindDescriptorSets(bindPoint, layout, firstSet, sets,
+                                dynamicOffsets);
+    for (uint32_t i = firstSet; i < kMaxDescriptorSets; i++) {
+        auto& bound = state.descriptorSets[i];
+        if (i < lastSet && trackable) {
+            bound = BoundDescriptorSet{sets.data()[i - firstSet], layout,
+                                       offsets};
+        } else if (i < lastSet ||
+                   (bound.has_value() && bound->layout != layout)) {
+            // Binding with a different layout may disturb higher sets.
+            bound.reset();
+        }
+    }
+}
+
+void CommandEncoder::bindVertexBuffers(
+    uint32_t firstBinding, vk::ArrayProxy<const vk::Buffer> buffers,
+    vk::ArrayProxy<const vk::DeviceSize> offsets) {
+    uint32_t lastBinding = firstBinding + buffers.size();
+    bool redundant = lastBinding <= kMaxVertexBindings;
+    for (uint32_t i = firstBinding; i < lastBinding && redundant; i++) {
+        const auto& bound = m_vertexBuffers[i];
+        redundant = bound.has_value() &&
+                    bound->first == buffers.data()[i - firstBinding] &&
+                    bound->second == offsets.data()[i - firstBinding];
+    }
+    if (redundant) {
+        m_statistics.elided++;
+        return;
+    }
+    m_statistics.issued++;
+    m_buffer.bindVertexBuffers(firstBinding, buffers, offsets);
+    for (uint32_t i = firstBinding;
+         i < std::min(lastBinding, kMaxVertexBindings); i++) {
+        m_vertexBuffers[i] = std::make_pair(buffers.data()[i - firstBinding],
+                                            offsets.data()[i - firstBinding]);
+    }
+}
+
+void CommandEncoder::bindIndexBuffer(vk::Buffer buffer, vk::DeviceSize offset,
+                                     vk::IndexType indexType) {
+    IndexBufferState state{buffer, offset, indexType};
+    if (m_indexBuffer.has_value() && m_indexBuffer->buffer == buffer &&
+        m_indexBuffer->offset == offset &&
+        m_indexBuffer->indexType == indexType) {
+        m_statistics.elided++;
+        return;
+    }
+    m_indexBuffer = state;
+    m_statistics.issued++;
+    m_buffer.bindIndexBuffer(buffer, offset, indexType);
+}
+
+void CommandEncoder::pushConstants(vk::PipelineLayout layout,
+                                   vk::ShaderStageFlags stages,
+                                   uint32_t offset, uint32_t size,
+                                   const void* values) {
+    const auto* bytes = static_cast<const std::byte*>(values);
+    bool tracked = offset + size <= kMaxPushConstantSize;
+    if (layout != m_pushConstantLayout) {
+        m_pushConstantStages.fill({});
+        m_pushConstantLayout = layout;
+    }
+    if (tracked &&
+        std::all_of(m_pushConstantStages.begin() + offset,
+                    m_pushConstantStages.begin() + offset + size,
+                    [&](vk::ShaderStageFlags s) { return s == stages; }) &&
+        std::memcmp(m_pushConstantValues.data() + offset, bytes, size) == 0) {
+        m_statistics.elided++;
+        return;
+    }
+    m_statistics.issued++;
+    m_buffer.pushConstants<std::byte>(
+        layout, stages, offset, vk::ArrayProxy<const std::byte>(size, bytes));
+    if (tracked) {
+        std::memcpy(m_pushConstantValues.data() + offset, bytes, size);
+        std::fill(m_pushConstantStages.begin() + offset,
+                  m_pushConstantStages.begin() + offset + size, stages);
+    } else {
+        // The tracked part of the range was overwritten too; forget it so
+        // that a later push into it is never elided against stale bytes.
+        std::fill(m_pushConstantStages.begin() +
+                      std::min<size_t>(offset, kMaxPushConstantSize),
+                  m_pushConstantStages.end(), vk::ShaderStageFlags{});
+    }
+}
+
+void CommandEncoder::setViewport(const vk::Viewport& viewport) {
+    if (elide(m_viewport, viewport)) return;
+    m_buffer.setViewport(0, viewport);
+}
+
+void CommandEncoder::setScissor(const vk::Rect2D& scissor) {
+    if (elide(m_scissor, scissor)) return;
+    m_buffer.setScissor(0, scissor);
+}
+
+void CommandEncoder::setLineWidth(float lineWidth) {
+    if (elide(m_lineWidth, lineWidth)) return;
+    m_buffer.setLineWidth(lineWidth);
+}
+
+void CommandEncoder::setBlendConstants(const std::array<float, 4>& constants) {
+    if (elide(m_blendConstants, constants)) return;
+    m_buffer.setBlendConstants(constants.data());
+}
+
+void CommandEncoder::setStencilReference(vk::StencilFaceFlags faceMask,
+                                         uint32_t reference) {
+    if (elide(m_stencilReference, std::make_pair(faceMask, reference))) return;
+    m_buffer.setStencilReference(faceMask, reference);
+}
+
+void CommandEncoder::draw(uint32_t vertexCount, uint32_t instanceCount,
+                          uint32_t firstVertex, uint32_t firstInstance) {
+    m_statistics.issued++;
+    m_statistics.draws++;
+    m_buffer.draw(vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void CommandEncoder::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+                                 uint32_t firstIndex, int32_t vertexOffset,
+                                 uint32_t firstInstance) {
+    m_statistics.issued++;
+    m_statistics.draws++;
+    m_buffer.drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset,
+                         firstInstance);
+}
+
+void CommandEncoder::invalidate() noexcept {
+    m_graphics = {};
+    m_compute = {};
+    m_vertexBuffers.fill(std::nullopt);
+    m_indexBuffer.reset();
+    m_pushConstantLayout = nullptr;
+    m_pushConstantStages.fill({});
+    m_viewport.reset();
+    m_scissor.reset();
+    m_lineWidth.reset();
+    m_blendConstants.reset();
+    m_stencilReference.reset();
+}
+
+const vk::raii::CommandBuffer& CommandEncoder::getBuffer() const noexcept {
+    return m_buffer;
+}
+
+const CommandEncoder::Statistics& CommandEncoder::getStatistics()
+    const noexcept {
+    return m_statistics;
+}
+} // namespace compound
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace compound {
+// Thin wrapper over a command buffer that remembers the state it already
+// bound and drops calls that would not change it. Dynamic state is tracked
+// across pipeline binds, which is valid as long as every bound pipeline
+// declares that state dynamic; call invalidate() otherwise.
+class CommandEncoder {
+public:
+    struct Statistics {
+        uint32_t issued = 0;
+        uint32_t elided = 0;
+        uint32_t draws = 0;
+        uint32_t pipelineBinds = 0;
+    };
+
+    static constexpr uint32_t kMaxDescriptorSets = 8;
+    static constexpr uint32_t kMaxVertexBindings = 16;
+    static constexpr uint32_t kMaxPushConstantSize = 256;
+
+    explicit CommandEncoder(const vk::raii::CommandBuffer& buffer);
+
+    void bindPipeline(vk::PipelineBindPoint bindPoint, vk::Pipeline pipeline);
+    void bindDescriptorSets(vk::PipelineBindPoint bindPoint,
+                            vk::PipelineLayout layout, uint32_t firstSet,
+                            vk::ArrayProxy<const vk::DescriptorSet> sets,
+                            vk::ArrayProxy<const uint32_t> dynamicOffsets = {});
+    void bindVertexBuffers(uint32_t firstBinding,
+                           vk::ArrayProxy<const vk::Buffer> buffers,
+                           vk::ArrayProxy<const vk::DeviceSize> offsets);
+    void bindIndexBuffer(vk::Buffer buffer, vk::DeviceSize offset,
+                         vk::IndexType indexType);
+    void pushConstants(vk::PipelineLayout layout, vk::ShaderStageFlags stages,
+                       uint32_t offset, uint32_t size, const void* values);
+    void setViewport(const vk::Viewport& viewport);
+    void setScissor(const vk::Rect2D& scissor);
+    void setLineWidth(float lineWidth);
+    void setBlendConstants(const std::array<float, 4>& constants);
+    void setStencilReference(vk::StencilFaceFlags faceMask, uint32_t reference);
+
+    void draw(uint32_t vertexCount, uint32_t instanceCount,
+              uint32_t firstVertex, uint32_t firstInstance);
+    void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+                     uint32_t firstIndex, int32_t vertexOffset,
+                     uint32_t firstInstance);
+
+    void invalidate() noexcept;
+    const vk::raii::CommandBuffer& getBuffer() const noexcept;
+    const Statistics& getStatistics() const noexcept;
+
+private:
+    struct BoundDescriptorSet {
+        vk::DescriptorSet set;
+        vk::PipelineLayout layout;
+        std::vector<uint32_t> dynamicOffsets;
+    };
+    struct BindPointState {
+        vk::Pipeline pipeline;
+        std::array<std::optional<BoundDescriptorSet>, kMaxDescriptorSets>
+            descriptorSets;
+    };
+    struct IndexBufferState {
+        vk::Buffer buffer;
+        vk::DeviceSize offset;
+        vk::IndexType indexType;
+    };
+
+    const vk::raii::CommandBuffer& m_buffer;
+    Statistics m_statistics;
+    BindPointState m_graphics;
+    BindPointState m_compute;
+    std::array<std::optional<std::pair<vk::Buffer, vk::DeviceSize>>,
+               kMaxVertexBindings>
+        m_vertexBuffers;
+    std::optional<IndexBufferState> m_indexBuffer;
+    vk::PipelineLayout m_pushConstantLayout;
+    std::array<std::byte, kMaxPushConstantSize> m_pushConstantValues{};
+    std::array<vk::ShaderStageFlags, kMaxPushConstantSize>
+        m_pushConstantStages{};
+    std::optional<vk::Viewport> m_viewport;
+    std::optional<vk::Rect2D> m_scissor;
+    std::optional<float> m_lineWidth;
+    std::optional<std::array<float, 4>> m_blendConstants;
+    std::optional<std::pair<vk::StencilFaceFlags, uint32_t>> m_stencilReference;
+
+    BindPointState& getBindPointState(vk::PipelineBindPoint bindPoint);
+    template <typename T>
+    bool elide(std::optional<T>& tracked, const T& value) noexcept;
+};
+} // namespace compound
@@ -1,5 +1,14 @@
 #include "commandstructs.hpp"
 
+#include "defragmenter.hpp"
+#include "dynamicresolution.hpp"
+#include "framecapture.hpp"
+#include "gputimer.hpp"
+#include "occlusionqueries.hpp"
+#include "overlay.hpp"
+#include "pipelinestatistics.hpp"
+#include "texturestreamer.hpp"
+
 namespace compound {
 CommandPool::CommandPool(const Device& device, uint32_t queueFamilyIndex)
     : m_commandPool(0) {
@@ -25,39 +34,143 @@ CommandBuffer::CommandBuffer(const Device& device,
 }
 
 void CommandBuffer::record(const Swapchain& swapchain, const Pipeline& pipeline,
-                           const Framebuffer& framebuffer) const {
+                           const Framebuffer& framebuffer,
+                           const RecordOptions& options) const {
     vk::CommandBufferBeginInfo beginInfo{};
     m_buffer.begin(beginInfo);
+    if (options.gpuTimer) {
+        options.gpuTimer->begin(m_buffer);
+    }
+    if (options.defragmenter) {
+        options.defragmenter->record(m_buffer, options.frame);
+    }
+    if (options.textures) {
+        options.textures->record(m_buffer, options.frame);
+    }
+    if (options.occlusion) {
+        options.occlusion->queries->begin(m_buffer);
+    }
+    if (options.pipelineStatistics) {
+        options.pipelineStatistics->reset(m_buffer);
+        options.pipelineStatistics->begin(m_buffer, "main");
+    }
+    // With dynamic resolution the main pass renders into the scaled region
+    // of an offscreen target, blitted to the swapchain image afterwards.
+    const auto* dynamicResolution = options.dynamicResolution;
+    vk::Extent2D extent = dynamicResolution
+                              ? dynamicResolution->getRenderExtent()
+                              : swapchain.getExtent();
     vk::RenderPassBeginInfo renderpassBeginInfo{};
-    renderpassBeginInfo.setRenderPass(*pipeline.getRenderpass());
-    renderpassBeginInfo.setFramebuffer(*framebuffer.getFramebuffer());
-    renderpassBeginInfo.setRenderArea(vk::Rect2D({0, 0}, swapchain.getExtent()));
-    auto clearValue = vk::ClearValue({0.0f, 0.0f, 0.0f, 1.0f});
-    renderpassBeginInfo.setClearValues(clearValue);
+    if (dynamicResolution) {
+        renderpassBeginInfo.setRenderPass(
+            *dynamicResolution->getRenderPass());
+        renderpassBeginInfo.setFramebuffer(
+            *dynamicResolution->getFramebuffer().getFramebuffer());
+    } else {
+        renderpassBeginInfo.setRenderPass(*pipeline.getRenderpass());
+        renderpassBeginInfo.setFramebuffer(*framebuffer.getFramebuffer());
+    }
+    renderpassBeginInfo.setRenderArea(vk::Rect2D({0, 0}, extent));
+    auto clearValues = getClearValues(pipeline.getRenderPassState(),
+                                      {0.0f, 0.0f, 0.0f, 1.0f});
+    renderpassBeginInfo.setClearValues(clearValues);
     m_buffer.beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
 
-    m_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline.getPipeline());
+    CommandEncoder encoder(m_buffer);
+    recordMainPass(encoder, pipeline, extent, options.occlusion);
+    m_buffer.endRenderPass();
+    if (options.occlusion) {
+        options.occlusion->queries->end(m_buffer);
+    }
+    if (options.pipelineStatistics) {
+        options.pipelineStatistics->end(m_buffer);
+    }
+    // Further windows reuse the pipeline and dynamic state still bound from
+    // the primary pass.
+    for (const auto& target : options.targets) {
+        vk::Extent2D targetExtent = target.swapchain->getExtent();
+        vk::RenderPassBeginInfo targetBeginInfo{};
+        targetBeginInfo.setRenderPass(*pipeline.getRenderpass());
+        targetBeginInfo.setFramebuffer(*target.framebuffer->getFramebuffer());
+        targetBeginInfo.setRenderArea(vk::Rect2D({0, 0}, targetExtent));
+        targetBeginInfo.setClearValues(clearValues);
+        m_buffer.beginRenderPass(targetBeginInfo,
+                                 vk::SubpassContents::eInline);
+        recordMainPass(encoder, pipeline, targetExtent);
+        m_buffer.endRenderPass();
+    }
+    if (dynamicResolution) {
+        dynamicResolution->recordBlit(
+            m_buffer, swapchain.getImages()[options.imageIndex]);
+    }
+    if (options.capture) {
+        options.capture->recordCopy(
+            m_buffer, swapchain.getImages()[options.imageIndex], options.frame);
+    }
+    if (options.overlay) {
+        if (options.pipelineStatistics) {
+            options.pipelineStatistics->begin(m_buffer, "overlay");
+        }
+        options.overlay->record(m_buffer, options.imageIndex,
+                                swapchain.getExtent());
+        if (options.pipelineStatistics) {
+            options.pipelineStatistics->end(m_buffer);
+        }
+    }
+    if (options.gpuTimer) {
+        options.gpuTimer->end(m_buffer);
+    }
+    m_buffer.end();
+    m_statistics = encoder.getStatistics();
+}
+
+void CommandBuffer::recordMainPass(CommandEncoder& encoder,
+                                   const Pipeline& pipeline,
+                                   const vk::Extent2D& extent,
+                                   const OcclusionRecord* occlusion) const {
+    encoder.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                         *pipeline.getPipeline());
 
     vk::Viewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = swapchain.getExtent().width;
-    viewport.height = swapchain.getExtent().height;
+    viewport.width = extent.width;
+    viewport.height = extent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    m_buffer.setViewport(0, viewport);
+    encoder.setViewport(viewport);
 
     vk::Rect2D scissor{};
     scissor.setOffset({0, 0});
-    scissor.setExtent(swapchain.getExtent());
-    m_buffer.setScissor(0, scissor);
+    scissor.setExtent(extent);
+    encoder.setScissor(scissor);
 
-    m_buffer.draw(3, 1, 0, 0);
-    m_buffer.endRenderPass();
-    m_buffer.end();
+    if (!occlusion) {
+        encoder.draw(3, 1, 0, 0);
+        return;
+    }
+    // The GPU skips the draw itself with conditional rendering, otherwise
+    // the results read back after the last frame decide.
+    auto& queries = *occlusion->queries;
+    if (queries.usesConditionalRendering() || queries.isVisible(0)) {
+        queries.beginConditional(m_buffer, 0);
+        encoder.draw(3, 1, 0, 0);
+        queries.endConditional(m_buffer);
+    }
+    encoder.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                         occlusion->proxyPipeline);
+    queries.beginQuery(m_buffer, 0);
+    OcclusionQueries::drawProxy(encoder, occlusion->proxyLayout,
+                                occlusion->viewProjection, occlusion->box);
+    queries.endQuery(m_buffer, 0);
 }
 
 const vk::raii::CommandBuffer& CommandBuffer::getBuffer() const noexcept {
     return m_buffer;
 }
+
+const CommandEncoder::Statistics& CommandBuffer::getStatistics()
+    const noexcept {
+    return m_statistics;
+}
 } // namespace compound
\ No newline at end of file
@@ -6,8 +6,55 @@
 #include "pipeline.hpp"
 #include "swapchain.hpp"
 #include "framebuffer.hpp"
+#include "commandencoder.hpp"
+#include "bvh.hpp"
+#include <span>
 
 namespace compound {
+class Overlay;
+class GpuTimer;
+class DynamicResolution;
+class FrameCapture;
+class PipelineStatistics;
+class TextureStreamer;
+class Defragmenter;
+class OcclusionQueries;
+
+// A further window drawn in the same command buffer as the primary one. Only
+// the main pass is recorded into it.
+struct TargetRecord {
+    const Swapchain* swapchain = nullptr;
+    const Framebuffer* framebuffer = nullptr;
+};
+
+// Occlusion culling of the main pass's draw, which is object 0 of queries.
+// The proxy of its box is drawn right after it, in clip space once
+// transformed by viewProjection.
+struct OcclusionRecord {
+    OcclusionQueries* queries = nullptr;
+    vk::Pipeline proxyPipeline;
+    vk::PipelineLayout proxyLayout;
+    glm::mat4 viewProjection{1.0f};
+    Aabb box;
+};
+
+// Optional work recorded around the main pass. imageIndex is the acquired
+// swapchain image and frame the frame being recorded, both filled in by the
+// render loop.
+struct RecordOptions {
+    const Overlay* overlay = nullptr;
+    const GpuTimer* gpuTimer = nullptr;
+    const DynamicResolution* dynamicResolution = nullptr;
+    FrameCapture* capture = nullptr;
+    PipelineStatistics* pipelineStatistics = nullptr;
+    TextureStreamer* textures = nullptr;
+    Defragmenter* defragmenter = nullptr;
+    const OcclusionRecord* occlusion = nullptr;
+    std::span<const TargetRecord> targets;
+    uint32_t imageIndex = 0;
+    uint64_t frame = 0;
+};
+
 class CommandPool {
 public:
     CommandPool(const Device& device, uint32_t queueFamilyIndex);
@@ -19,9 +66,14 @@ private:
 class CommandBuffer {
 public:
     CommandBuffer(const Device& device, const CommandPool& commandPool);
-    void record(const Swapchain& swapchain, const Pipeline& pipeline, const Framebuffer& framebuffer) const;
+    void record(const Swapchain& swapchain, const Pipeline& pipeline, const Framebuffer& framebuffer, const RecordOptions& options = {}) const;
     const vk::raii::CommandBuffer& getBuffer() const noexcept;
+    const CommandEncoder::Statistics& getStatistics() const noexcept;
 private:
     vk::raii::CommandBuffer m_buffer;
+    mutable CommandEncoder::Statistics m_statistics;
+    void recordMainPass(CommandEncoder& encoder, const Pipeline& pipeline,
+                        const vk::Extent2D& extent,
+                        const OcclusionRecord* occlusion = nullptr) const;
 };
 }
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "defragmenter.hpp"
+
+#include <log4cplus/loggingmacros.h>
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <variant>
+
+namespace compound {
+namespace {
+vk::ImageAspectFlags getAspect(vk::Format format) noexcept {
+    using enum vk::Format;
+    switch (format) {
+    case eD16Unorm:
+    case eX8D24UnormPack32:
+    case eD32Sfloat:
+        return vk::ImageAspectFlagBits::eDepth;
+    case eS8Uint:
+        return vk::ImageAspectFlagBits::eStencil;
+    case eD16UnormS8Uint:
+    case eD24UnormS8Uint:
+    case eD32SfloatS8Uint:
+        return vk::ImageAspectFlagBits::eDepth |
+               vk::ImageAspectFlagBits::eStencil;
+    default:
+        return vk::ImageAspectFlagBits::eColor;
+    }
+}
+} // namespace
+
+Defragmenter::Defragmenter(const Device& device, Allocator& allocator)
+    : m_device(*device.getDevice()), m_allocator(allocator) {
+    setMovable(MemoryCategory::eMesh, true);
+    setMovable(MemoryCategory::eTexture, true);
+    setMovable(MemoryCategory::eUniform, true);
+}
+
+Defragmenter::~Defragmenter() {
+    if (m_passActive) {
+        // Nothing was switched yet, so every move is simply dropped.
+        std::lock_guard lock(m_allocator.m_ownerMutex);
+        for (auto& move : m_moves) {
+            bool abandoned =
+                m_allocator.m_abandoned.contains(move.move->srcAllocation);
+            move.move->operation =
+                abandoned ? VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY
+                          : VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            m_device.destroyBuffer(move.relocation.newBuffer);
+            m_device.destroyImage(move.relocation.newImage);
+        }
+        vmaEndDefragmentationPass(m_allocator.getAllocator(), m_context,
+                                  &m_pass);
+        m_allocator.m_moving.clear();
+        m_allocator.m_abandoned.clear();
+    }
+    if (m_context) {
+        vmaEndDefragmentation(m_allocator.getAllocator(), m_context, nullptr);
+    }
+}
+
+void Defragmenter::setPassBudget(vk::DeviceSize bytes, uint32_t allocations,
+                                 double milliseconds) noexcept {
+    m_passBytes = bytes;
+    m_passAllocations = allocations;
+    m_passMilliseconds = milliseconds;
+}
+
+void Defragmenter::setThreshold(float threshold) noexcept {
+    m_threshold = threshold;
+}
+
+void Defragmenter::setMovable(MemoryCategory category, bool movable) noexcept {
+    m_movable[static_cast<size_t>(category)] = movable;
+}
+
+void Defragmenter::addListener(Listener listener) {
+    m_listeners.push_back(std::move(listener));
+}
+
+void Defragmenter::start() {
+    if (m_context) {
+        return;
+    }
+    m_statistics = {};
+    m_statistics.fragmentationBefore = getFragmentation();
+    VmaDefragmentationInfo info{};
+    info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    info.maxBytesPerPass = m_passBytes;
+    info.maxAllocationsPerPass = m_passAllocations;
+    if (vmaBeginDefragmentation(m_allocator.getAllocator(), &info,
+                                &m_context) != VK_SUCCESS) {
+        LOG4CPLUS_ERROR(m_logger, "Failed to begin defragmentation");
+        throw std::runtime_error("Failed to begin defragmentation");
+    }
+    m_statistics.running = true;
+    LOG4CPLUS_INFO(m_logger,
+                   std::format("Starting defragmentation at {:.1f}% "
+                               "fragmentation",
+                               m_statistics.fragmentationBefore * 100.0f));
+}
+
+bool Defragmenter::isRunning() const noexcept {
+    return m_context != nullptr;
+}
+
+bool Defragmenter::prepare(Move& move) {
+    VmaAllocation destination = move.move->dstTmpAllocation;
+    VmaAllocator allocator = m_allocator.getAllocator();
+    auto transfer = vk::BufferUsageFlagBits::eTransferSrc |
+                    vk::BufferUsageFlagBits::eTransferDst;
+    if (auto* const* buffer = std::get_if<Buffer*>(&move.owner)) {
+        const auto& owner = **buffer;
+        if (!m_movable[static_cast<size_t>(owner.m_category)] ||
+            (owner.m_usage & transfer) != transfer) {
+            return false;
+        }
+        vk::BufferCreateInfo createInfo{};
+        createInfo.setSize(owner.m_size);
+        createInfo.setUsage(owner.m_usage);
+        createInfo.setSharingMode(vk::SharingMode::eExclusive);
+        auto newBuffer = m_device.createBuffer(createInfo);
+        if (vmaBindBufferMemory(allocator, destination, newBuffer) !=
+            VK_SUCCESS) {
+            m_device.destroyBuffer(newBuffer);
+            return false;
+        }
+        move.relocation = {owner.m_category, owner.m_buffer, newBuffer, {}, {}};
+        move.size = owner.m_size;
+        return true;
+    }
+    const auto& owner = *std::get<Image*>(move.owner);
+    const auto& createInfo = owner.m_createInfo;
+    auto imageTransfer = vk::ImageUsageFlagBits::eTransferSrc |
+                         vk::ImageUsageFlagBits::eTransferDst;
+    if (!m_movable[static_cast<size_t>(owner.m_category)] ||
+        (createInfo.usage & imageTransfer) != imageTransfer ||
+        createInfo.sharingMode != vk::SharingMode::eExclusive) {
+        return false;
+    }
+    auto newImage = m_device.createImage(createInfo);
+    if (vmaBindImageMemory(allocator, destination, newImage) != VK_SUCCESS) {
+        m_device.destroyImage(newImage);
+        return false;
+    }
+    move.relocation = {owner.m_category, {}, {}, owner.m_image, newImage};
+    move.size = owner.m_allocationSize;
+    move.imageInfo = createInfo;
+    return true;
+}
+
+void Defragmenter::record(const vk::raii::CommandBuffer& buffer,
+                          uint64_t frame) {
+    if (!m_context) {
+        if (frame % kCheckInterval != 0 || getFragmentation() <= m_threshold) {
+            return;
+        }
+        start();
+    }
+    if (m_passActive) {
+        return;
+    }
+    auto passStart = std::chrono::steady_clock::now();
+    VkResult result = vmaBeginDefragmentationPass(m_allocator.getAllocator(),
+                                                  m_context, &m_pass);
+    if (result == VK_SUCCESS) {
+        finish();
+        return;
+    }
+    if (result != VK_INCOMPLETE) {
+        LOG4CPLUS_ERROR(m_logger, "Failed to begin a defragmentation pass");
+        throw std::runtime_error("Failed to begin a defragmentation pass");
+    }
+
+    {
+        std::lock_guard lock(m_allocator.m_ownerMutex);
+        for (uint32_t i = 0; i < m_pass.moveCount; i++) {
+            auto& vmaMove = m_pass.pMoves[i];
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - passStart;
+            auto owner = m_allocator.m_owners.find(vmaMove.srcAllocation);
+            Move move{&vmaMove, {}, {}, 0, {}};
+            if (owner != m_allocator.m_owners.end()) {
+                move.owner = owner->second;
+            }
+            // Allocations without a Buffer or Image owner cannot have their
+            // references rewritten, so they stay where they are.
+            if ((m_passMilliseconds > 0.0 &&
+                 elapsed.count() > m_passMilliseconds) ||
+                owner == m_allocator.m_owners.end() || !prepare(move)) {
+                vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                continue;
+            }
+            m_allocator.m_moving.insert(vmaMove.srcAllocation);
+            m_moves.push_back(move);
+        }
+    }
+    m_passActive = true;
+    m_passFrame = frame;
+    if (m_moves.empty()) {
+        return;
+    }
+
+    std::vector<vk::ImageMemoryBarrier> before;
+    std::vector<vk::ImageMemoryBarrier> after;
+    auto addBarrier = [](std::vector<vk::ImageMemoryBarrier>& barriers,
+                         vk::Image image, const vk::ImageCreateInfo& info,
+                         vk::AccessFlags srcAccess, vk::AccessFlags dstAccess,
+                         vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+        auto& barrier = barriers.emplace_back();
+        barrier.setSrcAccessMask(srcAccess);
+        barrier.setDstAccessMask(dstAccess);
+        barrier.setOldLayout(oldLayout);
+        barrier.setNewLayout(newLayout);
+        barrier.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
+        barrier.setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+        barrier.setImage(image);
+        barrier.setSubresourceRange(vk::ImageSubresourceRange(
+            getAspect(info.format), 0, info.mipLevels, 0, info.arrayLayers));
+    };
+    using enum vk::ImageLayout;
+    using Access = vk::AccessFlagBits;
+    for (const auto& move : m_moves) {
+        const auto& relocation = move.relocation;
+        if (!relocation.newImage) {
+            continue;
+        }
+        addBarrier(before, relocation.oldImage, move.imageInfo,
+                   Access::eShaderRead, Access::eTransferRead,
+                   eShaderReadOnlyOptimal, eTransferSrcOptimal);
+        addBarrier(before, relocation.newImage, move.imageInfo, {},
+                   Access::eTransferWrite, eUndefined, eTransferDstOptimal);
+        addBarrier(after, relocation.oldImage, move.imageInfo,
+                   Access::eTransferRead, Access::eShaderRead,
+                   eTransferSrcOptimal, eShaderReadOnlyOptimal);
+        addBarrier(after, relocation.newImage, move.imageInfo,
+                   Access::eTransferWrite, Access::eShaderRead,
+                   eTransferDstOptimal, eShaderReadOnlyOptimal);
+    }
+    if (!before.empty()) {
+        buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+                               vk::PipelineStageFlagBits::eTransfer, {}, {},
+                               {}, before);
+    }
+    for (const auto& move : m_moves) {
+        const auto& relocation = move.relocation;
+        if (relocation.newBuffer) {
+            buffer.copyBuffer(relocation.oldBuffer, relocation.newBuffer,
+                              vk::BufferCopy(0, 0, move.size));
+            continue;
+        }
+        const auto& info = move.imageInfo;
+        std::vector<vk::ImageCopy> regions;
+        for (uint32_t level = 0; level < info.mipLevels; level++) {
+            auto& region = regions.emplace_back();
+            region.setSrcSubresource(
+                {getAspect(info.format), level, 0, info.arrayLayers});
+            region.setDstSubresource(
+                {getAspect(info.format), level, 0, info.arrayLayers});
+            region.setExtent({std::max(info.extent.width >> level, 1u),
+                              std::max(info.extent.height >> level, 1u),
+                              std::max(info.extent.depth >> level, 1u)});
+        }
+        buffer.copyImage(relocation.oldImage, eTransferSrcOptimal,
+                         relocation.newImage, eTransferDstOptimal, regions);
+    }
+    vk::MemoryBarrier copied(Access::eTransferWrite,
+                             Access::eMemoryRead | Access::eMemoryWrite);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                           vk::PipelineStageFlagBits::eAllCommands, {},
+                           copied, {}, after);
+}
+
+void Defragmenter::collect(uint64_t completedFrame) {
+    if (!m_passActive || completedFrame < m_passFrame) {
+        return;
+    }
+    std::vector<Relocation> relocations;
+    VkResult result;
+    {
+        std::lock_guard lock(m_allocator.m_ownerMutex);
+        for (auto& move : m_moves) {
+            if (m_allocator.m_abandoned.contains(move.move->srcAllocation)) {
+                move.move->operation =
+                    VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+                m_device.destroyBuffer(move.relocation.newBuffer);
+                m_device.destroyImage(move.relocation.newImage);
+            }
+        }
+        result = vmaEndDefragmentationPass(m_allocator.getAllocator(),
+                                           m_context, &m_pass);
+        // The allocations now point at their new place, switch the objects
+        // holding them over to the resources bound there.
+        for (const auto& move : m_moves) {
+            if (move.move->operation !=
+                VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY) {
+                continue;
+            }
+            // The object may have been moved since the pass was recorded,
+            // so the owner cached then can be stale.
+            auto owner = m_allocator.m_owners.find(move.move->srcAllocation);
+            if (owner == m_allocator.m_owners.end()) {
+                m_device.destroyBuffer(move.relocation.newBuffer);
+                m_device.destroyImage(move.relocation.newImage);
+                continue;
+            }
+            if (auto* const* buffer = std::get_if<Buffer*>(&owner->second)) {
+                VmaAllocationInfo info{};
+                vmaGetAllocationInfo(m_allocator.getAllocator(),
+                                     move.move->srcAllocation, &info);
+                (*buffer)->m_buffer = move.relocation.newBuffer;
+                (*buffer)->m_mappedData = info.pMappedData;
+            } else {
+                std::get<Image*>(owner->second)->m_image =
+                    move.relocation.newImage;
+            }
+            relocations.push_back(move.relocation);
+            m_statistics.bytesMoved += move.size;
+            m_statistics.allocationsMoved++;
+        }
+        m_allocator.m_moving.clear();
+        m_allocator.m_abandoned.clear();
+    }
+    for (const auto& relocation : relocations) {
+        for (const auto& listener : m_listeners) {
+            listener(relocation);
+        }
+        m_device.destroyBuffer(relocation.oldBuffer);
+        m_device.destroyImage(relocation.oldImage);
+    }
+    m_moves.clear();
+    m_passActive = false;
+    m_statistics.passes++;
+    if (result == VK_SUCCESS) {
+        finish();
+    }
+}
+
+void Defragmenter::finish() {
+    vmaEndDefragmentation(m_allocator.getAllocator(), m_context, nullptr);
+    m_context = nullptr;
+    m_statistics.running = false;
+    m_statistics.fragmentationAfter = getFragmentation();
+    LOG4CPLUS_INFO(
+        m_logger,
+        std::format("Defragmentation moved {} bytes in {} allocations over {} "
+                    "passes, fragmentation {:.1f}% -> {:.1f}%",
+                    m_statistics.bytesMoved, m_statistics.allocationsMoved,
+                    m_statistics.passes,
+                    m_statistics.fragmentationBefore * 100.0f,
+                    m_statistics.fragmentationAfter * 100.0f));
+}
+
+float Defragmenter::getFragmentation() const {
+    VmaTotalStatistics statistics{};
+    vmaCalculateStatistics(m_allocator.getAllocator(), &statistics);
+    const auto& total = statistics.total.statistics;
+    if (total.blockBytes == 0) {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(total.allocationBytes) /
+                      static_cast<float>(total.blockBytes);
+}
+
+const Defragmenter::Statistics& Defragmenter::getStatistics() const noexcept {
+    return m_statistics;
+}
+} // namespace compound
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+#include "device.hpp"
+#include "allocator.hpp"
+#include <log4cplus/log4cplus.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace compound {
+// Compacts device memory a little every frame using VMA's incremental
+// defragmentation. A pass is recorded into the frame's command buffer,
+// copying a bounded amount of live allocations into their new place, and
+// ended at the frame boundary once that frame completed: only then do the
+// Buffer and Image objects switch to their new handles, listeners rewrite
+// whatever references the old ones (views, descriptors, addresses) and the
+// emptied blocks are freed.
+//
+// Moved resources keep being read through their old handles during the pass
+// frame, so GPU writes to them in that frame would be lost; by default only
+// meshes, textures and uniforms move. Images must rest in the shader read
+// layout between frames.
+class Defragmenter {
+public:
+    // Handles of a moved resource, the new ones already held by its object.
+    struct Relocation {
+        MemoryCategory category;
+        vk::Buffer oldBuffer;
+        vk::Buffer newBuffer;
+        vk::Image oldImage;
+        vk::Image newImage;
+    };
+    using Listener = std::function<void(const Relocation& relocation)>;
+    struct Statistics {
+        float fragmentationBefore = 0.0f;
+        float fragmentationAfter = 0.0f;
+        uint64_t bytesMoved = 0;
+        uint64_t allocationsMoved = 0;
+        uint64_t passes = 0;
+        bool running = false;
+    };
+
+    // Frames between two fragmentation checks while idle.
+    static constexpr uint64_t kCheckInterval = 300;
+
+    Defragmenter(const Device& device, Allocator& allocator);
+    Defragmenter(const Defragmenter&) = delete;
+    Defragmenter& operator=(const Defragmenter&) = delete;
+    ~Defragmenter();
+    // Limits of a single pass; a time of zero disables the time limit.
+    void setPassBudget(vk::DeviceSize bytes, uint32_t allocations,
+                       double milliseconds) noexcept;
+    // Starts automatically once the fragmentation ratio is above threshold.
+    void setThreshold(float threshold) noexcept;
+    void setMovable(MemoryCategory category, bool movable) noexcept;
+    // Listeners are called on the render thread at the frame boundary, when
+    // the GPU no longer uses the old handles.
+    void addListener(Listener listener);
+    void start();
+    bool isRunning() const noexcept;
+    // Begins the next pass and records its copies; call it first in the
+    // command buffer, outside a render pass.
+    void record(const vk::raii::CommandBuffer& buffer, uint64_t frame);
+    // Ends the running pass once its frame completed.
+    void collect(uint64_t completedFrame);
+    // Share of the memory in allocated blocks not used by any allocation.
+    float getFragmentation() const;
+    const Statistics& getStatistics() const noexcept;
+
+private:
+    struct Move {
+        VmaDefragmentationMove* move;
+        // Only valid while recording; the object may move before collect.
+        Allocator::Owner owner;
+        Relocation relocation;
+        vk::DeviceSize size;
+        vk::ImageCreateInfo imageInfo;
+    };
+
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.defragmenter");
+    vk::Device m_device;
+    Allocator& m_allocator;
+    VmaDefragmentationContext m_context = nullptr;
+    VmaDefragmentationPassMoveInfo m_pass{};
+    bool m_passActive = false;
+    uint64_t m_passFrame = 0;
+    std::vector<Move> m_moves;
+    vk::DeviceSize m_passBytes = 16 * 1024 * 1024;
+    uint32_t m_passAllocations = 64;
+    double m_passMilliseconds = 0.5;
+    float m_threshold = 0.3f;
+    std::array<bool, kMemoryCategoryCount> m_movable{};
+    std::vector<Listener> m_listeners;
+    Statistics m_statistics;
+
+    bool prepare(Move& move);
+    void finish();
+};
+} // namespace compound
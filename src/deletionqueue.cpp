@@ -0,0 +1,58 @@
+#include "deletionqueue.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace compound {
+DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void DeletionQueue::retire(VmaAllocator allocator, VmaAllocation allocation,
+                           uint64_t lastUsed) {
+    push(std::shared_ptr<void>(allocation,
+                               [allocator](void* a) {
+                                   vmaFreeMemory(
+                                       allocator,
+                                       static_cast<VmaAllocation>(a));
+                               }),
+         lastUsed);
+}
+
+void DeletionQueue::push(std::shared_ptr<void>&& object, uint64_t lastUsed) {
+    std::lock_guard lock(m_mutex);
+    // Retirements arrive in frame order almost always, so searching from the
+    // back keeps the queue sorted at constant cost.
+    auto it = std::upper_bound(
+        m_entries.rbegin(), m_entries.rend(), lastUsed,
+        [](uint64_t value, const Entry& e) { return value >= e.lastUsed; });
+    m_entries.insert(it.base(), Entry{lastUsed, std::move(object)});
+}
+
+void DeletionQueue::collect(uint64_t completed) {
+    std::vector<Entry> ready;
+    {
+        std::lock_guard lock(m_mutex);
+        while (!m_entries.empty() && m_entries.front().lastUsed <= completed) {
+            ready.push_back(std::move(m_entries.front()));
+            m_entries.pop_front();
+        }
+    }
+    // Destroy outside the lock so retiring from other threads never waits on
+    // driver calls.
+    ready.clear();
+}
+
+void DeletionQueue::flush() {
+    std::deque<Entry> entries;
+    {
+        std::lock_guard lock(m_mutex);
+        entries.swap(m_entries);
+    }
+}
+
+size_t DeletionQueue::size() const noexcept {
+    std::lock_guard lock(m_mutex);
+    return m_entries.size();
+}
+} // namespace compound
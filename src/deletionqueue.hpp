@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace compound {
+// Holds objects that may still be referenced by submitted GPU work until the
+// frame (or timeline value) they were last used in has completed, then
+// destroys them in one batch.
+class DeletionQueue {
+public:
+    DeletionQueue() = default;
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+    ~DeletionQueue();
+
+    template <typename T>
+    void retire(T&& object, uint64_t lastUsed) {
+        push(std::make_shared<std::remove_cvref_t<T>>(std::forward<T>(object)),
+             lastUsed);
+    }
+    void retire(VmaAllocator allocator, VmaAllocation allocation,
+                uint64_t lastUsed);
+    void collect(uint64_t completed);
+    void flush();
+    size_t size() const noexcept;
+
+private:
+    struct Entry {
+        uint64_t lastUsed;
+        std::shared_ptr<void> object;
+    };
+    mutable std::mutex m_mutex;
+    std::deque<Entry> m_entries;
+
+    void push(std::shared_ptr<void>&& object, uint64_t lastUsed);
+};
+} // namespace compound
@@ -17,17 +17,18 @@ Device::Device(const Init& init, const vk::raii::SurfaceKHR& surface)
     LOG4CPLUS_INFO(
         m_logger,
         std::format("Selected physical device {}",
-                    std::string(m_physicalDevice.getProperties().deviceName)));
-    listQueueFamilies(m_physicalDevice);
+                    std::string(m_info->properties.deviceName)));
+    listQueueFamilies(m_info->queueFamilies);
 
     LOG4CPLUS_INFO(m_logger, "Creating queues and device");
-    createDevice(init, surface);
+    createDevice(init);
 
 }
 
-int Device::scorePhysicalDevice(const vk::raii::PhysicalDevice& physicalDevice,
+int Device::scorePhysicalDevice(const PhysicalDeviceInfo& info,
+                                const std::vector<vk::Bool32>& surfaceSupport,
                                 const vk::raii::SurfaceKHR& surface) const noexcept {
-    auto properties = physicalDevice.getProperties();
+    const auto& properties = info.properties;
     int score = 0;
     if (properties.apiVersion < VK_API_VERSION_1_3) {
         return 0;
@@ -39,20 +40,19 @@ int Device::scorePhysicalDevice(const vk::raii::PhysicalDevice& physicalDevice,
         score += 500;
     }
     try {
-        queryGraphicsFamilyQueueIndex(physicalDevice);
-        queryPresentationFamilyQueueIndex(physicalDevice, surface);
+        selectGraphicsFamily(info.queueFamilies);
+        selectPresentationFamily(info.queueFamilies, surfaceSupport);
     } catch (std::exception& e) {
         score = 0;
     }
-    if (!checkDeviceExtensionSupport(physicalDevice)) score = 0;
-    if (!checkDeviceSwapchainSupport(physicalDevice, surface))
+    if (!checkDeviceExtensionSupport(info)) score = 0;
+    if (score > 0 && !checkDeviceSwapchainSupport(info.physicalDevice, surface))
         score = 0;
     return score;
 }
 
 void Device::selectPhysicalDevice(const Init& init, const vk::raii::SurfaceKHR& surface) {
-    std::vector<vk::raii::PhysicalDevice> availablePhysicalDevices =
-        init.getVkInstance().enumeratePhysicalDevices();
+    const auto& availablePhysicalDevices = init.getPhysicalDevices();
     if (availablePhysicalDevices.size() == 0) {
         LOG4CPLUS_ERROR(m_logger,
                         "No vulkan-compatible physical device found on system");
@@ -61,45 +61,128 @@ void Device::selectPhysicalDevice(const Init& init, const vk::raii::SurfaceKHR&
     }
     LOG4CPLUS_INFO(m_logger, "Selecting a physical device");
     int topScore = 0;
-    vk::raii::PhysicalDevice& selectedPhysicalDevice =
-        availablePhysicalDevices[0];
-    for (auto& physicalDevice : availablePhysicalDevices) {
-        int score = scorePhysicalDevice(physicalDevice, surface);
-        if (score < topScore) {
+    std::vector<vk::Bool32> selectedSurfaceSupport;
+    for (const auto& info : availablePhysicalDevices) {
+        // Surface support is the only per-family query that depends on the
+        // surface, so it is done once here and shared by scoring and creation.
+        std::vector<vk::Bool32> surfaceSupport(info.queueFamilies.size());
+        for (uint32_t i = 0; i < surfaceSupport.size(); i++) {
+            surfaceSupport[i] =
+                info.physicalDevice.getSurfaceSupportKHR(i, *surface);
+        }
+        int score = scorePhysicalDevice(info, surfaceSupport, surface);
+        if (score <= topScore) {
             continue;
         }
         topScore = score;
-        selectedPhysicalDevice = physicalDevice;
+        m_info = &info;
+        selectedSurfaceSupport = std::move(surfaceSupport);
     }
     if (topScore == 0) {
         LOG4CPLUS_ERROR(m_logger, "No physical device met the requirements");
         throw std::runtime_error("No physical device met the requirements");
     }
-    m_physicalDevice = selectedPhysicalDevice;
+    m_physicalDevice = m_info->physicalDevice;
+    m_graphicsQueueFamilyIndex = selectGraphicsFamily(m_info->queueFamilies);
+    m_presentationQueueFamilyIndex =
+        selectPresentationFamily(m_info->queueFamilies, selectedSurfaceSupport);
 }
 
-void Device::createDevice(const Init& init, const vk::raii::SurfaceKHR& surface) {
+void Device::createDevice(const Init& init) {
     vk::DeviceQueueCreateInfo graphicsQueueCreateInfo{};
-    m_graphicsQueueFamilyIndex =
-        queryGraphicsFamilyQueueIndex(m_physicalDevice);
     graphicsQueueCreateInfo.setQueueFamilyIndex(m_graphicsQueueFamilyIndex);
     graphicsQueueCreateInfo.queueCount = 1;
     float queuePriority = 1.0f;
     graphicsQueueCreateInfo.setQueuePriorities(queuePriority);
 
     vk::DeviceQueueCreateInfo presentationQueueCreateInfo{};
-    m_presentationQueueFamilyIndex =
-        queryPresentationFamilyQueueIndex(m_physicalDevice, surface);
     presentationQueueCreateInfo.setQueueFamilyIndex(
         m_presentationQueueFamilyIndex);
     presentationQueueCreateInfo.queueCount = 1;
     presentationQueueCreateInfo.setQueuePriorities(queuePriority);
+    std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos = {
+        graphicsQueueCreateInfo};
+    if (m_presentationQueueFamilyIndex != m_graphicsQueueFamilyIndex) {
+        queueCreateInfos.push_back(presentationQueueCreateInfo);
+    }
+
+    std::vector<const char*> extensions = m_extensions;
+    for (const auto& optionalExtension : m_optionalExtensions) {
+        if (m_info->extensions.contains(optionalExtension)) {
+            LOG4CPLUS_INFO(m_logger,
+                           std::format("Enabling optional extension {}",
+                                       optionalExtension));
+            extensions.push_back(optionalExtension);
+            m_enabledOptionalExtensions.insert(optionalExtension);
+        }
+    }
+
+    // Optional features are chained in front of pNext as they are found.
+    void* features = nullptr;
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT
+        graphicsPipelineLibraryFeatures{};
+    if (isExtensionEnabled(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+        isExtensionEnabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+        auto supported = m_physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+        m_graphicsPipelineLibrary =
+            supported
+                .get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>()
+                .graphicsPipelineLibrary;
+        graphicsPipelineLibraryFeatures.setGraphicsPipelineLibrary(
+            m_graphicsPipelineLibrary);
+        graphicsPipelineLibraryFeatures.setPNext(features);
+        features = &graphicsPipelineLibraryFeatures;
+    }
+    vk::PhysicalDeviceConditionalRenderingFeaturesEXT
+        conditionalRenderingFeatures{};
+    if (isExtensionEnabled(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME)) {
+        auto supported = m_physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceConditionalRenderingFeaturesEXT>();
+        m_conditionalRendering =
+            supported.get<vk::PhysicalDeviceConditionalRenderingFeaturesEXT>()
+                .conditionalRendering;
+        conditionalRenderingFeatures.setConditionalRendering(
+            m_conditionalRendering);
+        conditionalRenderingFeatures.setPNext(features);
+        features = &conditionalRenderingFeatures;
+    }
+
+    // Submission goes through vkQueueSubmit2, core in 1.3 but still a
+    // feature to enable.
+    auto vulkan13Features =
+        m_physicalDevice
+            .getFeatures2<vk::PhysicalDeviceFeatures2,
+                          vk::PhysicalDeviceVulkan13Features>()
+            .get<vk::PhysicalDeviceVulkan13Features>();
+    if (!vulkan13Features.synchronization2) {
+        LOG4CPLUS_ERROR(m_logger, "Device does not support synchronization2");
+        throw std::runtime_error("Device does not support synchronization2");
+    }
+    vk::PhysicalDeviceVulkan13Features enabledVulkan13Features{};
+    enabledVulkan13Features.setSynchronization2(true);
+    enabledVulkan13Features.setPNext(features);
+    features = &enabledVulkan13Features;
 
     vk::PhysicalDeviceFeatures physicalDeviceFeatures;
+    m_pipelineStatistics = m_info->features.pipelineStatisticsQuery;
+    // Mostly found on tiled GPUs, where transient attachments backed by it
+    // may never get physical memory.
+    auto memoryProperties = m_physicalDevice.getMemoryProperties();
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if (memoryProperties.memoryTypes[i].propertyFlags &
+            vk::MemoryPropertyFlagBits::eLazilyAllocated) {
+            m_lazilyAllocatedMemory = true;
+        }
+    }
+    physicalDeviceFeatures.setPipelineStatisticsQuery(m_pipelineStatistics);
     vk::DeviceCreateInfo deviceCreateInfo;
-    deviceCreateInfo.setQueueCreateInfos(graphicsQueueCreateInfo);
+    deviceCreateInfo.setPNext(features);
+    deviceCreateInfo.setQueueCreateInfos(queueCreateInfos);
     deviceCreateInfo.setPEnabledFeatures(&physicalDeviceFeatures);
-    deviceCreateInfo.setPEnabledExtensionNames(m_extensions);
+    deviceCreateInfo.setPEnabledExtensionNames(extensions);
     deviceCreateInfo.setPEnabledLayerNames(init.getLayers());
     m_device = m_physicalDevice.createDevice(deviceCreateInfo);
     m_graphicsQueue = m_device.getQueue(m_graphicsQueueFamilyIndex, 0);
@@ -107,15 +190,14 @@ void Device::createDevice(const Init& init, const vk::raii::SurfaceKHR& surface)
 }
 
 bool Device::checkDeviceExtensionSupport(
-    const vk::raii::PhysicalDevice& physicalDevice) const noexcept {
+    const PhysicalDeviceInfo& info) const noexcept {
     LOG4CPLUS_DEBUG(m_logger, "Checking device supports needed extensions");
-    std::set<std::string> requiredExtensions(m_extensions.begin(),
-                                             m_extensions.end());
-    for (const auto& availableExtension :
-         physicalDevice.enumerateDeviceExtensionProperties()) {
-        requiredExtensions.erase(availableExtension.extensionName);
+    for (const auto& extension : m_extensions) {
+        if (!info.extensions.contains(extension)) {
+            return false;
+        }
     }
-    return requiredExtensions.empty();
+    return true;
 }
 
 bool Device::checkDeviceSwapchainSupport(
@@ -132,7 +214,12 @@ bool Device::checkDeviceSwapchainSupport(
 
 void Device::listQueueFamilies(
     const vk::raii::PhysicalDevice& physicalDevice) const noexcept {
-    auto queuesProperties = physicalDevice.getQueueFamilyProperties();
+    listQueueFamilies(physicalDevice.getQueueFamilyProperties());
+}
+
+void Device::listQueueFamilies(
+    const std::vector<vk::QueueFamilyProperties>& queuesProperties)
+    const noexcept {
     for (size_t i = 0; i < queuesProperties.size(); i++) {
         const auto& queueProperties = queuesProperties[i];
         auto flags = queueProperties.queueFlags;
@@ -152,8 +239,12 @@ void Device::listQueueFamilies(
 
 [[maybe_unused]] uint32_t Device::queryGraphicsFamilyQueueIndex(
     const vk::raii::PhysicalDevice& physicalDevice) const {
+    return selectGraphicsFamily(physicalDevice.getQueueFamilyProperties());
+}
+
+uint32_t Device::selectGraphicsFamily(
+    const std::vector<vk::QueueFamilyProperties>& queuesProperties) const {
     LOG4CPLUS_DEBUG(m_logger, "Getting a queue family for graphics");
-    auto queuesProperties = physicalDevice.getQueueFamilyProperties();
     uint32_t selectedQueueFamilyIndex;
     int selectedQueueFamilyScore = 0;
     for (uint32_t i = 0; i < static_cast<uint32_t>(queuesProperties.size());
@@ -183,12 +274,25 @@ void Device::listQueueFamilies(
 [[maybe_unused]] uint32_t Device::queryPresentationFamilyQueueIndex(
     const vk::raii::PhysicalDevice& physicalDevice,
     const vk::raii::SurfaceKHR& surface) const {
-    LOG4CPLUS_DEBUG(m_logger, "Getting a queue family for presentation");
     auto queuesProperties = physicalDevice.getQueueFamilyProperties();
+    std::vector<vk::Bool32> surfaceSupport(queuesProperties.size());
+    for (uint32_t i = 0; i < surfaceSupport.size(); i++) {
+        surfaceSupport[i] = physicalDevice.getSurfaceSupportKHR(i, *surface);
+    }
+    return selectPresentationFamily(queuesProperties, surfaceSupport);
+}
+
+uint32_t Device::selectPresentationFamily(
+    const std::vector<vk::QueueFamilyProperties>& queuesProperties,
+    const std::vector<vk::Bool32>& surfaceSupport) const {
+    LOG4CPLUS_DEBUG(m_logger, "Getting a queue family for presentation");
     uint32_t selectedQueueFamilyIndex;
     int selectedQueueFamilyScore = 0;
     for (uint32_t i = 0; i < static_cast<uint32_t>(queuesProperties.size());
          i++) {
+        if (surfaceSupport[i] == VK_FALSE) {
+            continue;
+        }
         int score = 0;
         auto& queueProperties = queuesProperties[i];
         auto flags = queueProperties.queueFlags;
@@ -203,10 +307,6 @@ void Device::listQueueFamilies(
             selectedQueueFamilyIndex = i;
             selectedQueueFamilyScore = score;
         }
-        if (physicalDevice.getSurfaceSupportKHR(i, *surface) ==
-            VK_FALSE) {
-            score = 0;
-        }
     }
     if (selectedQueueFamilyScore == 0) {
         LOG4CPLUS_ERROR(m_logger, "No graphics-able family queue was found");
@@ -238,4 +338,34 @@ const vk::raii::Queue& Device::getGraphicsQueue() const noexcept {
 const vk::raii::Queue& Device::getPresentQueue() const noexcept {
     return m_presentationQueue;
 }
+
+bool Device::isExtensionEnabled(const std::string& extensionName)
+    const noexcept {
+    for (const auto& extension : m_extensions) {
+        if (extensionName == extension) {
+            return true;
+        }
+    }
+    return m_enabledOptionalExtensions.contains(extensionName);
+}
+
+bool Device::supportsGraphicsPipelineLibrary() const noexcept {
+    return m_graphicsPipelineLibrary;
+}
+
+bool Device::supportsConditionalRendering() const noexcept {
+    return m_conditionalRendering;
+}
+
+bool Device::supportsPipelineStatistics() const noexcept {
+    return m_pipelineStatistics;
+}
+
+bool Device::supportsLazilyAllocatedMemory() const noexcept {
+    return m_lazilyAllocatedMemory;
+}
+
+const vk::PhysicalDeviceProperties& Device::getProperties() const noexcept {
+    return m_info->properties;
+}
 } // namespace compound
\ No newline at end of file
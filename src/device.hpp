@@ -3,6 +3,8 @@
 #include <vulkan/vulkan_raii.hpp>
 #include "init.hpp"
 #include <log4cplus/logger.h>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace compound {
@@ -17,11 +19,25 @@ private:
     uint32_t m_presentationQueueFamilyIndex = 0;
     uint32_t m_presentationQueueCount = 0;
     vk::raii::Queue m_presentationQueue;
-    int scorePhysicalDevice(const vk::raii::PhysicalDevice&, const vk::raii::SurfaceKHR&) const noexcept;
+    const PhysicalDeviceInfo* m_info = nullptr;
+    int scorePhysicalDevice(const PhysicalDeviceInfo&, const std::vector<vk::Bool32>&, const vk::raii::SurfaceKHR&) const noexcept;
     void selectPhysicalDevice(const Init& init, const vk::raii::SurfaceKHR& surface);
-    void createDevice(const Init& init, const vk::raii::SurfaceKHR& surface);
+    void createDevice(const Init& init);
+    uint32_t selectGraphicsFamily(const std::vector<vk::QueueFamilyProperties>&) const;
+    uint32_t selectPresentationFamily(const std::vector<vk::QueueFamilyProperties>&, const std::vector<vk::Bool32>&) const;
+    void listQueueFamilies(const std::vector<vk::QueueFamilyProperties>&) const noexcept;
     std::vector<const char*> m_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-    bool checkDeviceExtensionSupport(const vk::raii::PhysicalDevice&) const noexcept;
+    std::vector<const char*> m_optionalExtensions = {
+        VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+        VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME};
+    std::set<std::string> m_enabledOptionalExtensions;
+    bool m_graphicsPipelineLibrary = false;
+    bool m_conditionalRendering = false;
+    bool m_pipelineStatistics = false;
+    bool m_lazilyAllocatedMemory = false;
+    bool checkDeviceExtensionSupport(const PhysicalDeviceInfo&) const noexcept;
     bool checkDeviceSwapchainSupport(const vk::raii::PhysicalDevice&, const vk::raii::SurfaceKHR&) const noexcept;
 public:
     Device(const Init&, const vk::raii::SurfaceKHR&);
@@ -35,5 +51,11 @@ public:
     const vk::raii::Queue& getGraphicsQueue() const noexcept;
     uint32_t getPresentationFamilyQueueIndex() const noexcept;
     const vk::raii::Queue& getPresentQueue() const noexcept;
+    bool isExtensionEnabled(const std::string&) const noexcept;
+    bool supportsGraphicsPipelineLibrary() const noexcept;
+    bool supportsConditionalRendering() const noexcept;
+    bool supportsPipelineStatistics() const noexcept;
+    bool supportsLazilyAllocatedMemory() const noexcept;
+    const vk::PhysicalDeviceProperties& getProperties() const noexcept;
 };
 }
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "dynamicresolution.hpp"
+
+#include "pipelinestate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+namespace compound {
+DynamicResolution::DynamicResolution(const Device& device,
+                                     Allocator& allocator,
+                                     const Swapchain& swapchain,
+                                     const RenderPassState& renderPass)
+    : m_extent(swapchain.getExtent()), m_renderpass(0) {
+    LOG4CPLUS_INFO(m_logger, "Creating dynamic resolution target");
+    auto features = device.getPhysicalDevice()
+                        .getFormatProperties(swapchain.getFormat())
+                        .optimalTilingFeatures;
+    if (!(features & vk::FormatFeatureFlagBits::eBlitSrc) ||
+        !(features & vk::FormatFeatureFlagBits::eBlitDst) ||
+        !(features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
+        LOG4CPLUS_ERROR(m_logger, "Swapchain format cannot be blitted");
+        throw std::runtime_error("Swapchain format cannot be blitted");
+    }
+    if (!(swapchain.getImageUsage() & vk::ImageUsageFlagBits::eTransferDst)) {
+        LOG4CPLUS_ERROR(m_logger, "Swapchain images cannot be blitted to");
+        throw std::runtime_error("Swapchain images cannot be blitted to");
+    }
+
+    // Same format as the swapchain so that pipelines built for the
+    // swapchain's render pass stay compatible.
+    vk::ImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.setImageType(vk::ImageType::e2D);
+    imageCreateInfo.setFormat(swapchain.getFormat());
+    imageCreateInfo.setExtent({m_extent.width, m_extent.height, 1});
+    imageCreateInfo.setMipLevels(1);
+    imageCreateInfo.setArrayLayers(1);
+    imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+    imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+    imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eColorAttachment |
+                             vk::ImageUsageFlagBits::eTransferSrc);
+    imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+    VmaAllocationCreateInfo allocationCreateInfo{};
+    allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+    m_image = allocator.createImage(imageCreateInfo, allocationCreateInfo,
+                                    MemoryCategory::eAttachment);
+
+    vk::ImageViewCreateInfo imageViewCreateInfo{};
+    imageViewCreateInfo.setImage(m_image.getImage());
+    imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+    imageViewCreateInfo.setFormat(swapchain.getFormat());
+    imageViewCreateInfo.setSubresourceRange(
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    m_imageViews.push_back(
+        device.getDevice().createImageView(imageViewCreateInfo));
+
+    RenderPassState renderPassState{};
+    renderPassState.colorFormat = swapchain.getFormat();
+    renderPassState.depthFormat = renderPass.depthFormat;
+    renderPassState.samples = renderPass.samples;
+    renderPassState.finalLayout = vk::ImageLayout::eTransferSrcOptimal;
+    m_renderpass = createRenderPass(device, renderPassState);
+    m_attachments.emplace(device, allocator, renderPassState, m_extent);
+
+    m_framebuffer = Framebuffer::create(device, m_imageViews, m_extent,
+                                        m_renderpass, m_attachments->getViews());
+}
+
+void DynamicResolution::update(const FrameTimings& timings) {
+    double frameTime = timings.gpu.value_or(timings.cpuFrame - timings.acquire -
+                                            timings.present);
+    m_averageFrameTime = m_averageFrameTime == 0.0
+                             ? frameTime
+                             : m_averageFrameTime * (1.0 - kSmoothing) +
+                                   frameTime * kSmoothing;
+    if (m_cooldown > 0) {
+        m_cooldown--;
+        return;
+    }
+    float scale = m_scale;
+    if (m_averageFrameTime > m_targetFrameTime) {
+        // Cost is roughly proportional to the pixel count, the square of the
+        // scale.
+        scale *= static_cast<float>(
+            std::sqrt(m_targetFrameTime / m_averageFrameTime));
+    } else if (m_averageFrameTime < m_targetFrameTime * kHeadroom) {
+        scale += kScaleStep;
+    }
+    scale = std::clamp(scale, m_minScale, m_maxScale);
+    if (scale != m_scale) {
+        LOG4CPLUS_DEBUG(m_logger,
+                        std::format("Render scale {:.2f} -> {:.2f} ({:.2f} ms)",
+                                    m_scale, scale, m_averageFrameTime));
+        m_scale = scale;
+        // Give the new resolution time to show in the measurements.
+        m_cooldown = kCooldownFrames;
+    }
+}
+
+void DynamicResolution::setTargetFrameTime(double milliseconds) noexcept {
+    m_targetFrameTime = milliseconds;
+}
+
+void DynamicResolution::setScaleRange(float minScale,
+                                      float maxScale) noexcept {
+    m_minScale = minScale;
+    m_maxScale = maxScale;
+    m_scale = std::clamp(m_scale, m_minScale, m_maxScale);
+}
+
+void DynamicResolution::setScale(float scale) noexcept {
+    m_scale = std::clamp(scale, m_minScale, m_maxScale);
+}
+
+float DynamicResolution::getScale() const noexcept {
+    return m_scale;
+}
+
+vk::Extent2D DynamicResolution::getRenderExtent() const noexcept {
+    auto scaled = [&](uint32_t size) {
+        return std::clamp(static_cast<uint32_t>(std::lround(size * m_scale)),
+                          1u, size);
+    };
+    return {scaled(m_extent.width), scaled(m_extent.height)};
+}
+
+const vk::raii::RenderPass& DynamicResolution::getRenderPass() const noexcept {
+    return m_renderpass;
+}
+
+const Framebuffer& DynamicResolution::getFramebuffer() const noexcept {
+    return m_framebuffer.front();
+}
+
+void DynamicResolution::recordBlit(const vk::raii::CommandBuffer& buffer,
+                                   vk::Image swapchainImage) const {
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0,
+                                    1);
+    // The render pass already left the target in the transfer source layout,
+    // this only orders the blit after the color writes.
+    std::array<vk::ImageMemoryBarrier, 2> before{};
+    before[0].setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+    before[0].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    before[0].setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    before[0].setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    before[0].setImage(m_image.getImage());
+    before[0].setSubresourceRange(range);
+    before[1].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    before[1].setOldLayout(vk::ImageLayout::eUndefined);
+    before[1].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+    before[1].setImage(swapchainImage);
+    before[1].setSubresourceRange(range);
+    for (auto& barrier : before) {
+        barrier.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
+        barrier.setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+    }
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                           vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                           before);
+
+    auto renderExtent = getRenderExtent();
+    vk::ImageBlit region{};
+    region.setSrcSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+    region.setSrcOffsets(
+        {vk::Offset3D{0, 0, 0},
+         vk::Offset3D{static_cast<int32_t>(renderExtent.width),
+                      static_cast<int32_t>(renderExtent.height), 1}});
+    region.setDstSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+    region.setDstOffsets({vk::Offset3D{0, 0, 0},
+                          vk::Offset3D{static_cast<int32_t>(m_extent.width),
+                                       static_cast<int32_t>(m_extent.height),
+                                       1}});
+    buffer.blitImage(m_image.getImage(), vk::ImageLayout::eTransferSrcOptimal,
+                     swapchainImage, vk::ImageLayout::eTransferDstOptimal,
+                     region, vk::Filter::eLinear);
+
+    vk::ImageMemoryBarrier after{};
+    after.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    after.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead |
+                           vk::AccessFlagBits::eColorAttachmentWrite);
+    after.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    after.setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+    after.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
+    after.setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+    after.setImage(swapchainImage);
+    after.setSubresourceRange(range);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                           vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                           {}, {}, {}, after);
+}
+} // namespace compound
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "swapchain.hpp"
+#include "allocator.hpp"
+#include "framebuffer.hpp"
+#include "renderloop.hpp"
+#include "transientattachments.hpp"
+#include <log4cplus/log4cplus.h>
+#include <optional>
+#include <vector>
+
+namespace compound {
+// Renders the main pass into a swapchain-sized offscreen target, of which
+// only a scaled region is used, and blits that region up to the swapchain
+// image. update() steers the scale so that the measured frame time, GPU time
+// when available, stays under the target. The scale shrinks as soon as the
+// average goes over budget and grows back slowly once there is headroom.
+class DynamicResolution {
+public:
+    // Depth and samples of the render pass are taken over from the main
+    // pass so that its pipelines stay compatible.
+    DynamicResolution(const Device& device, Allocator& allocator,
+                      const Swapchain& swapchain,
+                      const RenderPassState& renderPass = {});
+    void update(const FrameTimings& timings);
+    void setTargetFrameTime(double milliseconds) noexcept;
+    void setScaleRange(float minScale, float maxScale) noexcept;
+    void setScale(float scale) noexcept;
+    float getScale() const noexcept;
+    vk::Extent2D getRenderExtent() const noexcept;
+    const vk::raii::RenderPass& getRenderPass() const noexcept;
+    const Framebuffer& getFramebuffer() const noexcept;
+    // Expects the render pass to have ended; leaves the swapchain image in
+    // the present layout.
+    void recordBlit(const vk::raii::CommandBuffer& buffer,
+                    vk::Image swapchainImage) const;
+
+private:
+    static constexpr double kSmoothing = 0.1;
+    static constexpr double kHeadroom = 0.85;
+    static constexpr float kScaleStep = 0.05f;
+    static constexpr uint32_t kCooldownFrames = 8;
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.dynamicresolution");
+    vk::Extent2D m_extent;
+    Image m_image;
+    std::vector<vk::raii::ImageView> m_imageViews;
+    std::optional<TransientAttachments> m_attachments;
+    vk::raii::RenderPass m_renderpass;
+    std::vector<Framebuffer> m_framebuffer;
+    double m_targetFrameTime = 1000.0 / 60.0;
+    double m_averageFrameTime = 0.0;
+    float m_minScale = 0.5f;
+    float m_maxScale = 1.0f;
+    float m_scale = 1.0f;
+    uint32_t m_cooldown = 0;
+};
+} // namespace compound
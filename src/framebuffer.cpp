@@ -1,4 +1,5 @@
 #include "framebuffer.hpp"
+#include <algorithm>
 #include <iostream>
 
 namespace compound {
@@ -9,6 +10,13 @@ Framebuffer::Framebuffer(vk::raii::Framebuffer&& framebuffer)
 std::vector<Framebuffer> Framebuffer::create(
     const Device& device, const std::vector<vk::raii::ImageView>& imageViews,
     const vk::Extent2D& extent, const vk::raii::RenderPass& renderpass) {
+    return create(device, imageViews, extent, renderpass, {});
+}
+
+std::vector<Framebuffer> Framebuffer::create(
+    const Device& device, const std::vector<vk::raii::ImageView>& imageViews,
+    const vk::Extent2D& extent, const vk::raii::RenderPass& renderpass,
+    const std::vector<vk::ImageView>& attachments) {
     LOG4CPLUS_INFO(log4cplus::Logger::getInstance("compound.framebuffer"),
                    "Creating framebuffers from swapchain's imageviews and "
                    "pipeline's renderpass");
@@ -18,8 +26,11 @@ std::vector<Framebuffer> Framebuffer::create(
     createInfo.width = extent.width;
     createInfo.height = extent.height;
     createInfo.setLayers(1);
+    std::vector<vk::ImageView> views(attachments.size() + 1);
+    std::copy(attachments.begin(), attachments.end(), views.begin() + 1);
     for (const auto& imageView : imageViews) {
-        createInfo.setAttachments(*imageView);
+        views[0] = *imageView;
+        createInfo.setAttachments(views);
         framebuffers.push_back(
             std::move(Framebuffer(device.getDevice().createFramebuffer(createInfo))));
     }
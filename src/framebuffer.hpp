@@ -13,6 +13,12 @@ public:
     static std::vector<Framebuffer> create(
         const Device& device, const std::vector<vk::raii::ImageView>& imageViews,
         const vk::Extent2D& extent, const vk::raii::RenderPass& renderpass);
+    // Adds the same attachments after each image view, see
+    // TransientAttachments::getViews().
+    static std::vector<Framebuffer> create(
+        const Device& device, const std::vector<vk::raii::ImageView>& imageViews,
+        const vk::Extent2D& extent, const vk::raii::RenderPass& renderpass,
+        const std::vector<vk::ImageView>& attachments);
     const vk::raii::Framebuffer& getFramebuffer() const noexcept;
 
 private:
@@ -0,0 +1,261 @@
+#include "framecapture.hpp"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace compound {
+namespace {
+bool isBgra(vk::Format format) noexcept {
+    return format == vk::Format::eB8G8R8A8Srgb ||
+           format == vk::Format::eB8G8R8A8Unorm;
+}
+
+void toRgb(const CapturedFrame& frame, std::vector<char>& rgb) {
+    size_t pixels = static_cast<size_t>(frame.width) * frame.height;
+    rgb.resize(pixels * 3);
+    const auto* source = reinterpret_cast<const char*>(frame.pixels.data());
+    bool bgra = isBgra(frame.format);
+    for (size_t i = 0; i < pixels; i++) {
+        rgb[i * 3 + 0] = source[i * 4 + (bgra ? 2 : 0)];
+        rgb[i * 3 + 1] = source[i * 4 + 1];
+        rgb[i * 3 + 2] = source[i * 4 + (bgra ? 0 : 2)];
+    }
+}
+} // namespace
+
+FrameCapture::FrameCapture(const Device& device, Allocator& allocator,
+                           const Swapchain& swapchain, Consumer consumer,
+                           size_t ringSize)
+    : m_allocator(allocator),
+      m_extent(swapchain.getExtent()),
+      m_format(swapchain.getFormat()),
+      m_consumer(std::move(consumer)) {
+    LOG4CPLUS_INFO(m_logger, "Creating frame capture");
+    // Buffers and the rgb conversion assume 4-byte 8-bit RGBA or BGRA texels.
+    if (!isBgra(m_format) && m_format != vk::Format::eR8G8B8A8Srgb &&
+        m_format != vk::Format::eR8G8B8A8Unorm) {
+        LOG4CPLUS_ERROR(m_logger,
+                        std::format("Unsupported capture format {}",
+                                    vk::to_string(m_format)));
+        throw std::runtime_error("Unsupported capture format");
+    }
+    if (!(swapchain.getImageUsage() & vk::ImageUsageFlagBits::eTransferSrc)) {
+        LOG4CPLUS_ERROR(m_logger, "Swapchain images cannot be copied from");
+        throw std::runtime_error("Swapchain images cannot be copied from");
+    }
+    vk::BufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.setSize(static_cast<vk::DeviceSize>(m_extent.width) *
+                             m_extent.height * 4);
+    bufferCreateInfo.setUsage(vk::BufferUsageFlagBits::eTransferDst);
+    bufferCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
+    VmaAllocationCreateInfo allocationCreateInfo{};
+    allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                                 VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    for (size_t i = 0; i < ringSize; i++) {
+        auto slot = std::make_unique<Slot>();
+        slot->buffer = allocator.createBuffer(
+            bufferCreateInfo, allocationCreateInfo, MemoryCategory::eStaging);
+        m_slots.push_back(std::move(slot));
+    }
+    m_thread = std::jthread([this](std::stop_token st) { consume(st); });
+}
+
+FrameCapture::~FrameCapture() {
+    m_thread.request_stop();
+    m_thread.join();
+}
+
+void FrameCapture::setCapturing(bool capturing) noexcept {
+    m_capturing = capturing;
+}
+
+bool FrameCapture::isCapturing() const noexcept {
+    return m_capturing;
+}
+
+void FrameCapture::recordCopy(const vk::raii::CommandBuffer& buffer,
+                              vk::Image image, uint64_t frame) {
+    if (!m_capturing) {
+        return;
+    }
+    // Slots are freed in the order they were recorded, so only the next one
+    // can be free.
+    Slot& slot = *m_slots[m_next];
+    if (slot.state.load(std::memory_order_acquire) != SlotState::eFree) {
+        m_dropped++;
+        return;
+    }
+    slot.frame = frame;
+    slot.state.store(SlotState::eRecorded, std::memory_order_relaxed);
+    m_recorded.push_back(&slot);
+    m_next = (m_next + 1) % m_slots.size();
+
+    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0,
+                                    1);
+    vk::ImageMemoryBarrier before{};
+    before.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite |
+                            vk::AccessFlagBits::eTransferWrite);
+    before.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    before.setOldLayout(vk::ImageLayout::ePresentSrcKHR);
+    before.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    before.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
+    before.setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+    before.setImage(image);
+    before.setSubresourceRange(range);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                               vk::PipelineStageFlagBits::eTransfer,
+                           vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                           before);
+
+    vk::BufferImageCopy region{};
+    region.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+    region.setImageExtent({m_extent.width, m_extent.height, 1});
+    buffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal,
+                             slot.buffer.getBuffer(), region);
+
+    vk::MemoryBarrier hostRead{};
+    hostRead.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    hostRead.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                           vk::PipelineStageFlagBits::eHost, {}, hostRead, {},
+                           {});
+
+    vk::ImageMemoryBarrier after = before;
+    after.setSrcAccessMask({});
+    after.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead |
+                           vk::AccessFlagBits::eColorAttachmentWrite);
+    after.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    after.setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                           vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                           {}, {}, {}, after);
+}
+
+void FrameCapture::collect(uint64_t completedFrame) {
+    bool queued = false;
+    while (!m_recorded.empty() && m_recorded.front()->frame <= completedFrame) {
+        Slot* slot = m_recorded.front();
+        m_recorded.pop_front();
+        slot->state.store(SlotState::eQueued, std::memory_order_relaxed);
+        std::lock_guard lock(m_mutex);
+        m_queue.push_back(slot);
+        queued = true;
+    }
+    if (queued) {
+        m_condition.notify_one();
+    }
+}
+
+void FrameCapture::consume(std::stop_token stopToken) {
+    while (true) {
+        Slot* slot = nullptr;
+        {
+            std::unique_lock lock(m_mutex);
+            if (!m_condition.wait(lock, stopToken,
+                                  [&] { return !m_queue.empty(); })) {
+                return;
+            }
+            slot = m_queue.front();
+            m_queue.pop_front();
+        }
+        vmaInvalidateAllocation(m_allocator.getAllocator(),
+                                slot->buffer.getAllocation(), 0, VK_WHOLE_SIZE);
+        CapturedFrame frame{
+            slot->frame, m_extent.width, m_extent.height, m_format,
+            std::span<const std::byte>(
+                static_cast<const std::byte*>(slot->buffer.getMappedData()),
+                slot->buffer.getSize())};
+        try {
+            m_consumer(frame);
+            m_captured++;
+        } catch (std::exception& e) {
+            LOG4CPLUS_ERROR(m_logger,
+                            std::format("Frame consumer failed : {}",
+                                        e.what()));
+        }
+        slot->state.store(SlotState::eFree, std::memory_order_release);
+    }
+}
+
+FrameCapture::Statistics FrameCapture::getStatistics() const noexcept {
+    return {m_captured.load(), m_dropped.load()};
+}
+
+FrameCapture::Consumer FrameCapture::ppmSequence(
+    const std::filesystem::path& directory) {
+    // The directory is only created once there is a frame to write.
+    return [directory, rgb = std::vector<char>(), created = false](
+               const CapturedFrame& frame) mutable {
+        if (!created) {
+            std::filesystem::create_directories(directory);
+            created = true;
+        }
+        toRgb(frame, rgb);
+        auto path = directory / std::format("frame_{:06}.ppm", frame.frame);
+        std::ofstream file(path, std::ios::binary);
+        file << std::format("P6\n{} {}\n255\n", frame.width, frame.height);
+        file.write(rgb.data(), rgb.size());
+        if (!file) {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    };
+}
+
+FrameCapture::Consumer FrameCapture::pipe(
+    std::vector<std::string> arguments) {
+    if (arguments.empty()) {
+        throw std::runtime_error("No program to pipe captured frames to");
+    }
+    std::vector<char*> argv;
+    for (auto& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+    // Both ends are closed on exec, so that the program only inherits the
+    // read end as its standard input and sees the end of the stream once
+    // the write end here is closed.
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC) != 0) {
+        throw std::runtime_error("Failed to create capture pipe");
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    pid_t pid;
+    int spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(),
+                               environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[0]);
+    if (spawned != 0) {
+        close(fds[1]);
+        throw std::runtime_error("Failed to start " + arguments[0]);
+    }
+    FILE* file = fdopen(fds[1], "w");
+    if (file == nullptr) {
+        close(fds[1]);
+        waitpid(pid, nullptr, 0);
+        throw std::runtime_error("Failed to open capture pipe");
+    }
+    std::shared_ptr<FILE> stream(file, [pid](FILE* file) {
+        std::fclose(file);
+        waitpid(pid, nullptr, 0);
+    });
+    return [stream, rgb = std::vector<char>()](
+               const CapturedFrame& frame) mutable {
+        toRgb(frame, rgb);
+        if (std::fwrite(rgb.data(), 1, rgb.size(), stream.get()) !=
+            rgb.size()) {
+            throw std::runtime_error("Failed to write to capture pipe");
+        }
+    };
+}
+} // namespace compound
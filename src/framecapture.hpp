@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "swapchain.hpp"
+#include "allocator.hpp"
+#include <log4cplus/log4cplus.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace compound {
+// Tightly packed 4 byte per pixel image, valid during the consumer call.
+struct CapturedFrame {
+    uint64_t frame;
+    uint32_t width;
+    uint32_t height;
+    vk::Format format;
+    std::span<const std::byte> pixels;
+};
+
+// Copies presented images into a ring of host-visible buffers on the GPU and
+// hands them, in frame order, to a consumer running on its own thread once
+// their frame has completed. Recording never waits: when every buffer is
+// still in use the frame is dropped and counted.
+class FrameCapture {
+public:
+    using Consumer = std::function<void(const CapturedFrame& frame)>;
+    struct Statistics {
+        uint64_t captured = 0;
+        uint64_t dropped = 0;
+    };
+
+    FrameCapture(const Device& device, Allocator& allocator,
+                 const Swapchain& swapchain, Consumer consumer,
+                 size_t ringSize = 4);
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+    ~FrameCapture();
+    void setCapturing(bool capturing) noexcept;
+    bool isCapturing() const noexcept;
+    // Records the copy of a swapchain image, left in the present layout,
+    // for the given frame.
+    void recordCopy(const vk::raii::CommandBuffer& buffer, vk::Image image,
+                    uint64_t frame);
+    // Hands the copies of frames up to completedFrame to the consumer.
+    void collect(uint64_t completedFrame);
+    Statistics getStatistics() const noexcept;
+
+    // Writes every frame to directory/frame_<n>.ppm, creating the directory
+    // with the first one.
+    static Consumer ppmSequence(const std::filesystem::path& directory);
+    // Streams frames as raw rgb24 into the standard input of a program found
+    // on PATH, started without a shell, e.g. {"ffmpeg", "-f", "rawvideo",
+    // "-pix_fmt", "rgb24", "-s", "800x450", "-i", "-", "out.mp4"}.
+    static Consumer pipe(std::vector<std::string> arguments);
+
+private:
+    enum class SlotState { eFree, eRecorded, eQueued };
+    struct Slot {
+        Buffer buffer;
+        uint64_t frame = 0;
+        std::atomic<SlotState> state = SlotState::eFree;
+    };
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.framecapture");
+    Allocator& m_allocator;
+    vk::Extent2D m_extent;
+    vk::Format m_format;
+    Consumer m_consumer;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    size_t m_next = 0;
+    // Recorded slots in frame order, owned by the render thread.
+    std::deque<Slot*> m_recorded;
+    std::atomic<bool> m_capturing = false;
+    std::atomic<uint64_t> m_captured = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<Slot*> m_queue;
+    std::jthread m_thread;
+    void consume(std::stop_token stopToken);
+};
+} // namespace compound
@@ -0,0 +1,55 @@
+#include "gputimer.hpp"
+
+namespace compound {
+GpuTimer::GpuTimer(const Device& device) : m_queryPool(0) {
+    auto queueFamilies = device.getPhysicalDevice().getQueueFamilyProperties();
+    auto limits = device.getPhysicalDevice().getProperties().limits;
+    m_supported =
+        queueFamilies[device.getGraphicsFamilyQueueIndex()].timestampValidBits >
+        0;
+    m_timestampPeriod = limits.timestampPeriod;
+    if (!m_supported) {
+        return;
+    }
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.setQueryType(vk::QueryType::eTimestamp);
+    createInfo.setQueryCount(2);
+    m_queryPool = device.getDevice().createQueryPool(createInfo);
+}
+
+void GpuTimer::begin(const vk::raii::CommandBuffer& buffer) const {
+    if (!m_supported) {
+        return;
+    }
+    buffer.resetQueryPool(*m_queryPool, 0, 2);
+    m_recorded = true;
+    buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *m_queryPool,
+                          0);
+}
+
+void GpuTimer::end(const vk::raii::CommandBuffer& buffer) const {
+    if (!m_supported) {
+        return;
+    }
+    buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                          *m_queryPool, 1);
+}
+
+std::optional<double> GpuTimer::resolve() const {
+    if (!m_supported || !m_recorded) {
+        return std::nullopt;
+    }
+    auto [result, timestamps] = m_queryPool.getResults<uint64_t>(
+        0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return std::nullopt;
+    }
+    return static_cast<double>(timestamps[1] - timestamps[0]) *
+           m_timestampPeriod / 1e6;
+}
+
+bool GpuTimer::isSupported() const noexcept {
+    return m_supported;
+}
+} // namespace compound
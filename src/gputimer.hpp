@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include <optional>
+
+namespace compound {
+// Timestamp pair around a frame's commands. Results are fetched without
+// waiting, so resolve() reports the last frame whose fence has been waited on.
+class GpuTimer {
+public:
+    explicit GpuTimer(const Device& device);
+    void begin(const vk::raii::CommandBuffer& buffer) const;
+    void end(const vk::raii::CommandBuffer& buffer) const;
+    std::optional<double> resolve() const;
+    bool isSupported() const noexcept;
+
+private:
+    vk::raii::QueryPool m_queryPool;
+    double m_timestampPeriod = 0.0;
+    bool m_supported = false;
+    mutable bool m_recorded = false;
+};
+} // namespace compound
@@ -79,6 +79,8 @@ Init::Init() : m_context(), m_instance(0), m_debugMessenger(0) {
 
     vk::InstanceCreateInfo instanceCreateInfo{};
     instanceCreateInfo.pApplicationInfo = &applicationInfo;
+    m_availableExtensions = m_context.enumerateInstanceExtensionProperties();
+    m_availableLayers = m_context.enumerateInstanceLayerProperties();
     for (const auto& validationLayer : m_validationLayers) {
         if (!isLayerAvailable(validationLayer)) {
             throw std::runtime_error("Validation layer is not available.");
@@ -118,8 +120,8 @@ Init::Init() : m_context(), m_instance(0), m_debugMessenger(0) {
 
 void Init::logInstanceProperties() const noexcept {
     auto version = m_context.enumerateInstanceVersion();
-    auto extensions = m_context.enumerateInstanceExtensionProperties();
-    auto layers = m_context.enumerateInstanceLayerProperties();
+    const auto& extensions = m_availableExtensions;
+    const auto& layers = m_availableLayers;
     LOG4CPLUS_INFO(m_logger, std::format("Instance version : {}",
                                          std::to_string(version)));
     LOG4CPLUS_INFO(m_logger, "Available extensions :");
@@ -141,8 +143,7 @@ void Init::logInstanceProperties() const noexcept {
 
 bool Init::isExtensionAvailable(
     const std::string& extensionName) const noexcept {
-    auto extensions = m_context.enumerateInstanceExtensionProperties();
-    for (const auto& extension : extensions) {
+    for (const auto& extension : m_availableExtensions) {
         if (std::string(extension.extensionName) == extensionName) {
             LOG4CPLUS_DEBUG(m_logger,
                             std::format("Extension {} is available",
@@ -156,8 +157,7 @@ bool Init::isExtensionAvailable(
 }
 
 bool Init::isLayerAvailable(const std::string& layerName) const noexcept {
-    auto layers = m_context.enumerateInstanceLayerProperties();
-    for (const auto& layer : layers) {
+    for (const auto& layer : m_availableLayers) {
         if (std::string(layer.layerName) == layerName) {
             LOG4CPLUS_DEBUG(m_logger,
                             std::format("Layer {} is available",
@@ -200,4 +200,23 @@ const std::vector<const char*>& Init::getExtensions() const noexcept {
 const std::vector<const char*>& Init::getLayers() const noexcept {
     return m_validationLayers;
 }
+
+const std::vector<PhysicalDeviceInfo>& Init::getPhysicalDevices() const {
+    std::call_once(m_physicalDevicesOnce, [&] {
+        LOG4CPLUS_DEBUG(m_logger, "Probing physical devices");
+        for (auto& physicalDevice : m_instance.enumeratePhysicalDevices()) {
+            PhysicalDeviceInfo info{physicalDevice,
+                                    physicalDevice.getProperties(),
+                                    physicalDevice.getFeatures(),
+                                    physicalDevice.getQueueFamilyProperties(),
+                                    {}};
+            for (const auto& extension :
+                 physicalDevice.enumerateDeviceExtensionProperties()) {
+                info.extensions.insert(std::string(extension.extensionName));
+            }
+            m_physicalDevices.push_back(std::move(info));
+        }
+    });
+    return m_physicalDevices;
+}
 } // namespace compound
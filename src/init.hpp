@@ -3,9 +3,21 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_raii.hpp>
 #include <log4cplus/logger.h>
+#include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace compound {
+// Surface-independent capabilities of a physical device, queried once.
+struct PhysicalDeviceInfo {
+    vk::raii::PhysicalDevice physicalDevice;
+    vk::PhysicalDeviceProperties properties;
+    vk::PhysicalDeviceFeatures features;
+    std::vector<vk::QueueFamilyProperties> queueFamilies;
+    std::set<std::string> extensions;
+};
+
 class Init {
 private:
     log4cplus::Logger m_logger = log4cplus::Logger::getInstance("compound.init");
@@ -19,6 +31,10 @@ private:
     inline static std::vector<const char*> m_validationLayers {""};
 #endif
     std::vector<const char*> m_extensions;
+    std::vector<vk::ExtensionProperties> m_availableExtensions;
+    std::vector<vk::LayerProperties> m_availableLayers;
+    mutable std::once_flag m_physicalDevicesOnce;
+    mutable std::vector<PhysicalDeviceInfo> m_physicalDevices;
     Init();
     void logInstanceProperties() const noexcept;
     bool isExtensionAvailable(const std::string&) const noexcept;
@@ -30,6 +46,8 @@ public:
     const vk::raii::Instance& getVkInstance() const noexcept;
     const std::vector<const char*>& getExtensions() const noexcept;
     const std::vector<const char*>& getLayers() const noexcept;
+    // Enumerated on first use, safe to call from several threads.
+    const std::vector<PhysicalDeviceInfo>& getPhysicalDevices() const;
     ~Init();
 };
 } // namespace compound
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "spscqueue.hpp"
+
+namespace compound {
+// Input as forwarded from the GLFW callbacks of a Window. The framebuffer
+// size is not an event, it is sampled with each FrameInput instead.
+struct InputEvent {
+    enum class Type { eKey, eMouseButton, eCursor, eScroll, eClose };
+    Type type;
+    int code = 0;
+    int action = 0;
+    int mods = 0;
+    double x = 0.0;
+    double y = 0.0;
+};
+
+using EventQueue = SpscQueue<InputEvent, 1024>;
+} // namespace compound
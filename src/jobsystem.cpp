@@ -0,0 +1,202 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+#include <format>
+
+namespace compound {
+namespace {
+thread_local size_t t_workerIndex = SIZE_MAX;
+} // namespace
+
+JobSystem& JobSystem::get() {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+JobSystem::JobSystem() {
+    size_t workerCount =
+        std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    LOG4CPLUS_INFO(m_logger,
+                   std::format("Starting {} job workers", workerCount));
+    for (size_t i = 0; i < workerCount; i++) {
+        m_deques.push_back(std::make_unique<Deque>());
+    }
+    for (size_t i = 0; i < workerCount; i++) {
+        m_workers.emplace_back([this, i] { work(i); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    m_stopping = true;
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_all();
+    m_workers.clear();
+    for (auto& deque : m_deques) {
+        while (Job* job = deque->pop()) {
+            delete job;
+        }
+    }
+    for (Job* job : m_injection) {
+        delete job;
+    }
+    for (Job* job : m_deferred) {
+        delete job;
+    }
+}
+
+void JobSystem::run(Function function, Counter* counter,
+                    const Counter* dependency) {
+    if (counter != nullptr) {
+        counter->fetch_add(1, std::memory_order_relaxed);
+    }
+    submit(new Job{std::move(function), counter, dependency});
+}
+
+void JobSystem::submit(Job* job) {
+    if (t_workerIndex >= m_deques.size() ||
+        !m_deques[t_workerIndex]->push(job)) {
+        std::lock_guard lock(m_injectionMutex);
+        m_injection.push_back(job);
+    }
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+}
+
+void JobSystem::defer(Job* job) {
+    // Checked again under the lock that release() takes, so a dependency
+    // finishing concurrently cannot strand the job.
+    std::lock_guard lock(m_deferredMutex);
+    if (job->dependency->load(std::memory_order_acquire) == 0) {
+        submit(job);
+    } else {
+        m_deferred.push_back(job);
+    }
+}
+
+void JobSystem::release() {
+    std::vector<Job*> deferred;
+    {
+        std::lock_guard lock(m_deferredMutex);
+        deferred.swap(m_deferred);
+    }
+    for (Job* job : deferred) {
+        submit(job);
+    }
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_all();
+}
+
+JobSystem::Job* JobSystem::find() {
+    size_t count = m_deques.size();
+    size_t self = t_workerIndex;
+    if (self < count) {
+        if (Job* job = m_deques[self]->pop()) {
+            return job;
+        }
+    }
+    size_t start = self < count ? self + 1 : 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t victim = (start + i) % count;
+        if (victim == self) {
+            continue;
+        }
+        if (Job* job = m_deques[victim]->steal()) {
+            return job;
+        }
+    }
+    std::lock_guard lock(m_injectionMutex);
+    if (m_injection.empty()) {
+        return nullptr;
+    }
+    Job* job = m_injection.front();
+    m_injection.pop_front();
+    return job;
+}
+
+bool JobSystem::execute() {
+    Job* job = find();
+    if (job == nullptr) {
+        return false;
+    }
+    if (job->dependency != nullptr &&
+        job->dependency->load(std::memory_order_acquire) != 0) {
+        defer(job);
+        return false;
+    }
+    try {
+        job->function();
+    } catch (std::exception& e) {
+        LOG4CPLUS_ERROR(m_logger, std::format("Job failed : {}", e.what()));
+    }
+    if (job->counter != nullptr &&
+        job->counter->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        release();
+    }
+    delete job;
+    return true;
+}
+
+void JobSystem::work(size_t index) {
+    t_workerIndex = index;
+    while (!m_stopping.load(std::memory_order_acquire)) {
+        uint32_t signal = m_signal.load(std::memory_order_acquire);
+        if (!execute()) {
+            m_signal.wait(signal, std::memory_order_acquire);
+        }
+    }
+}
+
+void JobSystem::wait(const Counter& counter) {
+    while (counter.load(std::memory_order_acquire) != 0) {
+        if (!execute()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize,
+                            const RangeFunction& function) {
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (count <= grainSize) {
+        if (count > 0) {
+            function(0, count);
+        }
+        return;
+    }
+    Counter counter = 0;
+    // The first exception of a queued chunk, rethrown here instead of being
+    // swallowed by the worker that ran it.
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    for (size_t begin = grainSize; begin < count; begin += grainSize) {
+        size_t end = std::min(begin + grainSize, count);
+        run(
+            [&function, &errorMutex, &error, begin, end] {
+                try {
+                    function(begin, end);
+                } catch (...) {
+                    std::lock_guard lock(errorMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            },
+            &counter);
+    }
+    try {
+        function(0, grainSize);
+    } catch (...) {
+        // The queued chunks reference this frame.
+        wait(counter);
+        throw;
+    }
+    wait(counter);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+size_t JobSystem::getWorkerCount() const noexcept {
+    return m_workers.size();
+}
+} // namespace compound
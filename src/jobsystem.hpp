@@ -0,0 +1,72 @@
+#pragma once
+
+#include "workstealingdeque.hpp"
+#include <log4cplus/log4cplus.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace compound {
+// Process-wide work-stealing scheduler with one worker per hardware thread
+// besides the caller. Workers push follow-up jobs onto their own deque and
+// steal from the others when it runs dry; other threads submit through a
+// shared injection queue.
+//
+// A job may decrement a counter when it finishes and may depend on another
+// counter reaching zero before it starts. wait() runs pending jobs instead of
+// blocking, so it is safe to call from inside a job. Exceptions of jobs
+// queued with run() are logged; parallelFor rethrows the first one thrown by
+// any of its chunks.
+class JobSystem {
+public:
+    using Counter = std::atomic<uint32_t>;
+    using Function = std::function<void()>;
+    using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+    static JobSystem& get();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem();
+    void run(Function function, Counter* counter = nullptr,
+             const Counter* dependency = nullptr);
+    void wait(const Counter& counter);
+    void parallelFor(size_t count, size_t grainSize,
+                     const RangeFunction& function);
+    size_t getWorkerCount() const noexcept;
+
+private:
+    static constexpr size_t kDequeCapacity = 4096;
+    struct Job {
+        Function function;
+        Counter* counter;
+        const Counter* dependency;
+    };
+    using Deque = WorkStealingDeque<Job, kDequeCapacity>;
+
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.jobsystem");
+    std::vector<std::unique_ptr<Deque>> m_deques;
+    std::mutex m_injectionMutex;
+    std::deque<Job*> m_injection;
+    std::mutex m_deferredMutex;
+    std::vector<Job*> m_deferred;
+    std::atomic<uint32_t> m_signal = 0;
+    std::atomic<bool> m_stopping = false;
+    std::vector<std::jthread> m_workers;
+
+    JobSystem();
+    void submit(Job* job);
+    void defer(Job* job);
+    void release();
+    Job* find();
+    bool execute();
+    void work(size_t index);
+};
+} // namespace compound
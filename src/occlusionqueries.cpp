@@ -0,0 +1,200 @@
+#include "occlusionqueries.hpp"
+
+#include <algorithm>
+#include <format>
+
+namespace compound {
+OcclusionQueries::OcclusionQueries(const Device& device, Allocator& allocator,
+                                   uint32_t capacity)
+    : m_capacity(capacity),
+      m_conditionalRendering(device.supportsConditionalRendering()),
+      m_queryPool(0),
+      m_visible(capacity, 1) {
+    LOG4CPLUS_INFO(m_logger,
+                   std::format("Creating {} occlusion queries{}", capacity,
+                               m_conditionalRendering
+                                   ? " with conditional rendering"
+                                   : ""));
+    vk::QueryPoolCreateInfo queryPoolCreateInfo{};
+    queryPoolCreateInfo.setQueryType(vk::QueryType::eOcclusion);
+    queryPoolCreateInfo.setQueryCount(capacity);
+    m_queryPool = device.getDevice().createQueryPool(queryPoolCreateInfo);
+    if (m_conditionalRendering) {
+        vk::BufferCreateInfo bufferCreateInfo{};
+        bufferCreateInfo.setSize(capacity * sizeof(uint32_t));
+        bufferCreateInfo.setUsage(
+            vk::BufferUsageFlagBits::eConditionalRenderingEXT |
+            vk::BufferUsageFlagBits::eTransferDst);
+        bufferCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
+        VmaAllocationCreateInfo allocationCreateInfo{};
+        allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        m_predicates = allocator.createBuffer(
+            bufferCreateInfo, allocationCreateInfo, MemoryCategory::eQuery);
+    }
+}
+
+PipelineState OcclusionQueries::createProxyState(
+    const std::string& vertShaderPath, const std::string& fragShaderPath,
+    const RenderPassState& renderPass) {
+    PipelineState state{};
+    state.vertex.path = vertShaderPath;
+    state.fragment.path = fragShaderPath;
+    state.cullMode = vk::CullModeFlagBits::eNone;
+    state.colorWriteMask = {};
+    state.depthTestEnable = true;
+    state.depthWriteEnable = false;
+    state.renderPass = renderPass;
+    state.layout.pushConstantRanges = {vk::PushConstantRange(
+        vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4))};
+    return state;
+}
+
+void OcclusionQueries::drawProxy(CommandEncoder& encoder,
+                                 vk::PipelineLayout layout,
+                                 const glm::mat4& viewProjection,
+                                 const Aabb& box) {
+    // Maps the unit cube drawn by the proxy shader onto the box.
+    glm::mat4 model(1.0f);
+    model[0][0] = box.max.x - box.min.x;
+    model[1][1] = box.max.y - box.min.y;
+    model[2][2] = box.max.z - box.min.z;
+    model[3] = glm::vec4(box.min, 1.0f);
+    glm::mat4 boxToClip = viewProjection * model;
+    encoder.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0,
+                          sizeof(glm::mat4), &boxToClip);
+    encoder.draw(36, 1, 0, 0);
+}
+
+template <typename Function>
+void OcclusionQueries::forEachRun(std::vector<ObjectId>& objects,
+                                  Function&& function) {
+    std::sort(objects.begin(), objects.end());
+    objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+    for (size_t begin = 0; begin < objects.size();) {
+        size_t end = begin + 1;
+        while (end < objects.size() && objects[end] == objects[end - 1] + 1) {
+            end++;
+        }
+        function(objects[begin], static_cast<uint32_t>(end - begin));
+        begin = end;
+    }
+}
+
+void OcclusionQueries::begin(const vk::raii::CommandBuffer& buffer) {
+    if (m_conditionalRendering && !m_predicatesInitialized) {
+        buffer.fillBuffer(m_predicates.getBuffer(), 0, VK_WHOLE_SIZE, 1);
+        vk::MemoryBarrier barrier{};
+        barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+        barrier.setDstAccessMask(
+            vk::AccessFlagBits::eConditionalRenderingReadEXT);
+        buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eConditionalRenderingEXT, {}, barrier,
+            {}, {});
+        m_predicatesInitialized = true;
+    }
+    buffer.resetQueryPool(*m_queryPool, 0, m_capacity);
+    m_recording.clear();
+}
+
+void OcclusionQueries::beginQuery(const vk::raii::CommandBuffer& buffer,
+                                  ObjectId object) {
+    if (object >= m_capacity) {
+        LOG4CPLUS_ERROR(m_logger, "Occlusion query out of range");
+        throw std::runtime_error("Occlusion query out of range");
+    }
+    buffer.beginQuery(*m_queryPool, object, {});
+    m_recording.push_back(object);
+}
+
+void OcclusionQueries::endQuery(const vk::raii::CommandBuffer& buffer,
+                                ObjectId object) {
+    buffer.endQuery(*m_queryPool, object);
+}
+
+void OcclusionQueries::beginConditional(const vk::raii::CommandBuffer& buffer,
+                                        ObjectId object) const {
+    if (!m_conditionalRendering) {
+        return;
+    }
+    vk::ConditionalRenderingBeginInfoEXT beginInfo{};
+    beginInfo.setBuffer(m_predicates.getBuffer());
+    beginInfo.setOffset(object * sizeof(uint32_t));
+    buffer.beginConditionalRenderingEXT(beginInfo);
+}
+
+void OcclusionQueries::endConditional(
+    const vk::raii::CommandBuffer& buffer) const {
+    if (m_conditionalRendering) {
+        buffer.endConditionalRenderingEXT();
+    }
+}
+
+void OcclusionQueries::end(const vk::raii::CommandBuffer& buffer) {
+    if (m_conditionalRendering && !m_recording.empty()) {
+        vk::MemoryBarrier before{};
+        before.setSrcAccessMask(
+            vk::AccessFlagBits::eConditionalRenderingReadEXT);
+        before.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+        buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eConditionalRenderingEXT,
+            vk::PipelineStageFlagBits::eTransfer, {}, before, {}, {});
+        // Only queries issued this frame are copied, waiting on the GPU for
+        // them to finish; the other predicates keep their last value.
+        forEachRun(m_recording, [&](ObjectId first, uint32_t count) {
+            buffer.copyQueryPoolResults(*m_queryPool, first, count,
+                                        m_predicates.getBuffer(),
+                                        first * sizeof(uint32_t),
+                                        sizeof(uint32_t),
+                                        vk::QueryResultFlagBits::eWait);
+        });
+        vk::MemoryBarrier after{};
+        after.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+        after.setDstAccessMask(
+            vk::AccessFlagBits::eConditionalRenderingReadEXT);
+        buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eConditionalRenderingEXT, {}, after,
+            {}, {});
+    }
+    m_pending = std::move(m_recording);
+    m_recording.clear();
+}
+
+void OcclusionQueries::collect() {
+    m_statistics = {};
+    forEachRun(m_pending, [&](ObjectId first, uint32_t count) {
+        // Pairs of sample count and availability.
+        auto [result, values] = m_queryPool.getResults<uint32_t>(
+            first, count, count * 2 * sizeof(uint32_t), 2 * sizeof(uint32_t),
+            vk::QueryResultFlagBits::eWithAvailability);
+        for (uint32_t i = 0; i < count; i++) {
+            if (values[i * 2 + 1] == 0) {
+                continue;
+            }
+            bool visible = values[i * 2] != 0;
+            m_visible[first + i] = visible;
+            if (visible) {
+                m_statistics.visible++;
+            } else {
+                m_statistics.occluded++;
+            }
+        }
+        m_statistics.queried += count;
+    });
+    m_pending.clear();
+}
+
+bool OcclusionQueries::isVisible(ObjectId object) const noexcept {
+    return object >= m_capacity || m_visible[object] != 0;
+}
+
+bool OcclusionQueries::usesConditionalRendering() const noexcept {
+    return m_conditionalRendering;
+}
+
+const OcclusionQueries::Statistics& OcclusionQueries::getStatistics()
+    const noexcept {
+    return m_statistics;
+}
+} // namespace compound
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "allocator.hpp"
+#include "bvh.hpp"
+#include "commandencoder.hpp"
+#include "pipelinestate.hpp"
+#include <glm/glm.hpp>
+#include <log4cplus/log4cplus.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compound {
+// One occlusion query per object, issued around a cheap bounding box proxy
+// drawn after the occluders with depth test on and no writes. Each frame's
+// results decide the next frame's draws, so nothing waits on them:
+//  - with VK_EXT_conditional_rendering, end() copies the results into a
+//    predicate buffer on the GPU and draws recorded between
+//    beginConditional() and endConditional() are skipped by the GPU;
+//  - otherwise collect() reads back the results that are available after
+//    the frame's fence without waiting, and callers skip draws of objects
+//    for which isVisible() is false.
+// Proxies should be drawn every frame, occluded objects included, or they
+// will never be found visible again. Objects are visible until proven
+// otherwise.
+class OcclusionQueries {
+public:
+    using ObjectId = uint32_t;
+    struct Statistics {
+        uint32_t queried = 0;
+        uint32_t visible = 0;
+        uint32_t occluded = 0;
+    };
+
+    OcclusionQueries(const Device& device, Allocator& allocator,
+                     uint32_t capacity);
+    // State of a proxy pipeline for the given box shaders, which read a
+    // 64 byte boxToClip matrix from push constants.
+    static PipelineState createProxyState(const std::string& vertShaderPath,
+                                          const std::string& fragShaderPath,
+                                          const RenderPassState& renderPass);
+    static void drawProxy(CommandEncoder& encoder, vk::PipelineLayout layout,
+                          const glm::mat4& viewProjection, const Aabb& box);
+
+    // Outside of a render pass, before the frame's queries.
+    void begin(const vk::raii::CommandBuffer& buffer);
+    void beginQuery(const vk::raii::CommandBuffer& buffer, ObjectId object);
+    void endQuery(const vk::raii::CommandBuffer& buffer, ObjectId object);
+    void beginConditional(const vk::raii::CommandBuffer& buffer,
+                          ObjectId object) const;
+    void endConditional(const vk::raii::CommandBuffer& buffer) const;
+    // Outside of a render pass, after the frame's queries.
+    void end(const vk::raii::CommandBuffer& buffer);
+    // Once the frame's fence has been waited on, before the next begin().
+    void collect();
+    bool isVisible(ObjectId object) const noexcept;
+    bool usesConditionalRendering() const noexcept;
+    const Statistics& getStatistics() const noexcept;
+
+private:
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.occlusionqueries");
+    uint32_t m_capacity;
+    bool m_conditionalRendering;
+    vk::raii::QueryPool m_queryPool;
+    Buffer m_predicates;
+    bool m_predicatesInitialized = false;
+    std::vector<uint8_t> m_visible;
+    // Queried in the frame being recorded and in the one being collected.
+    std::vector<ObjectId> m_recording;
+    std::vector<ObjectId> m_pending;
+    Statistics m_statistics;
+    template <typename Function>
+    static void forEachRun(std::vector<ObjectId>& objects,
+                           Function&& function);
+};
+} // namespace compound
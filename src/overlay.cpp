@@ -0,0 +1,187 @@
+#include "overlay.hpp"
+
+#include "pipelinestate.hpp"
+#include <imgui.h>
+#include <imgui_impl_vulkan.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace compound {
+void Overlay::History::push(float value) noexcept {
+    values[offset] = value;
+    offset = (offset + 1) % kHistorySize;
+}
+
+float Overlay::History::max() const noexcept {
+    return *std::max_element(values.begin(), values.end());
+}
+
+Overlay::Overlay(const Init& init, const Device& device,
+                 const Swapchain& swapchain)
+    : m_descriptorPool(0), m_renderpass(0),
+      m_displaySize(swapchain.getExtent()) {
+    LOG4CPLUS_INFO(m_logger, "Creating overlay");
+    vk::DescriptorPoolSize poolSize{vk::DescriptorType::eCombinedImageSampler,
+                                    16};
+    vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+    descriptorPoolCreateInfo.setFlags(
+        vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+    descriptorPoolCreateInfo.setMaxSets(16);
+    descriptorPoolCreateInfo.setPoolSizes(poolSize);
+    m_descriptorPool =
+        device.getDevice().createDescriptorPool(descriptorPoolCreateInfo);
+
+    RenderPassState renderPassState{};
+    renderPassState.colorFormat = swapchain.getFormat();
+    renderPassState.colorLoadOp = vk::AttachmentLoadOp::eLoad;
+    m_renderpass = createRenderPass(device, renderPassState);
+    m_framebuffers = Framebuffer::create(device, swapchain.getImageViews(),
+                                         swapchain.getExtent(), m_renderpass);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;
+    ImGui::StyleColorsDark();
+    ImGui_ImplVulkan_InitInfo initInfo{};
+    initInfo.Instance = *init.getVkInstance();
+    initInfo.PhysicalDevice = *device.getPhysicalDevice();
+    initInfo.Device = *device.getDevice();
+    initInfo.QueueFamily = device.getGraphicsFamilyQueueIndex();
+    initInfo.Queue = *device.getGraphicsQueue();
+    initInfo.DescriptorPool = *m_descriptorPool;
+    initInfo.RenderPass = *m_renderpass;
+    initInfo.MinImageCount = swapchain.getImageViews().size();
+    initInfo.ImageCount = swapchain.getImageViews().size();
+    initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    if (!ImGui_ImplVulkan_Init(&initInfo)) {
+        LOG4CPLUS_ERROR(m_logger, "Failed to initialize ImGui");
+        throw std::runtime_error("Failed to initialize ImGui");
+    }
+    // The font upload submits to the graphics queue, which belongs to the
+    // submission thread once frames are drawn, so it cannot be left to the
+    // first NewFrame.
+    if (!ImGui_ImplVulkan_CreateFontsTexture()) {
+        LOG4CPLUS_ERROR(m_logger, "Failed to upload ImGui fonts");
+        throw std::runtime_error("Failed to upload ImGui fonts");
+    }
+}
+
+Overlay::~Overlay() {
+    ImGui_ImplVulkan_Shutdown();
+    ImGui::DestroyContext();
+}
+
+void Overlay::plot(const char* label, const History& history) const {
+    char text[32];
+    size_t last = (history.offset + kHistorySize - 1) % kHistorySize;
+    std::snprintf(text, sizeof(text), "%.2f ms", history.values[last]);
+    ImGui::PlotLines(label, history.values.data(), kHistorySize,
+                     history.offset, text, 0.0f,
+                     std::max(history.max(), 1.0f), ImVec2(240, 40));
+}
+
+void Overlay::update(const FrameTimings& timings,
+                     const CommandEncoder::Statistics& statistics,
+                     const Allocator* allocator,
+                     const PipelineStatistics* pipelineStatistics) {
+    m_cpuFrame.push(timings.cpuFrame);
+    m_fenceWait.push(timings.fenceWait);
+    m_acquire.push(timings.acquire);
+    m_present.push(timings.present);
+    if (timings.gpu.has_value()) {
+        m_gpu.push(timings.gpu.value());
+        m_hasGpuTime = true;
+    }
+    if (!m_visible) {
+        return;
+    }
+
+    auto& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(static_cast<float>(m_displaySize.width),
+                            static_cast<float>(m_displaySize.height));
+    io.DeltaTime = std::max(timings.cpuFrame / 1000.0, 1e-4);
+    ImGui_ImplVulkan_NewFrame();
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(8, 8));
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("compound", nullptr,
+                 ImGuiWindowFlags_NoDecoration |
+                     ImGuiWindowFlags_AlwaysAutoResize |
+                     ImGuiWindowFlags_NoFocusOnAppearing |
+                     ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoInputs);
+    plot("cpu frame", m_cpuFrame);
+    plot("fence wait", m_fenceWait);
+    plot("acquire", m_acquire);
+    plot("present", m_present);
+    if (m_hasGpuTime) {
+        plot("gpu", m_gpu);
+    }
+    ImGui::Separator();
+    ImGui::Text("draws %u  pipeline binds %u", statistics.draws,
+                statistics.pipelineBinds);
+    ImGui::Text("commands issued %u  elided %u", statistics.issued,
+                statistics.elided);
+    if (allocator != nullptr) {
+        ImGui::Separator();
+        for (size_t i = 0; i < kMemoryCategoryCount; i++) {
+            auto category = static_cast<MemoryCategory>(i);
+            ImGui::Text("%-12s %8.2f MiB", toString(category),
+                        allocator->getCategoryUsage(category) / 1048576.0);
+        }
+        for (const auto& heap : allocator->getHeapBudgets()) {
+            ImGui::Text("heap %u %8.2f / %8.2f MiB", heap.heap,
+                        heap.usage / 1048576.0, heap.budget / 1048576.0);
+        }
+    }
+    if (pipelineStatistics != nullptr) {
+        for (const auto& scope : pipelineStatistics->getScopes()) {
+            const auto& counters = scope.counters;
+            ImGui::Separator();
+            ImGui::Text("%s", scope.name.c_str());
+            ImGui::Text("ia verts %llu  prims %llu",
+                        static_cast<unsigned long long>(
+                            counters.inputAssemblyVertices),
+                        static_cast<unsigned long long>(
+                            counters.inputAssemblyPrimitives));
+            ImGui::Text("vs %llu  clip %llu / %llu  fs %llu",
+                        static_cast<unsigned long long>(
+                            counters.vertexShaderInvocations),
+                        static_cast<unsigned long long>(
+                            counters.clippingInvocations),
+                        static_cast<unsigned long long>(
+                            counters.clippingPrimitives),
+                        static_cast<unsigned long long>(
+                            counters.fragmentShaderInvocations));
+        }
+    }
+    ImGui::End();
+    ImGui::Render();
+}
+
+void Overlay::record(const vk::raii::CommandBuffer& buffer,
+                     uint32_t imageIndex, const vk::Extent2D& extent) const {
+    if (!m_visible || ImGui::GetDrawData() == nullptr) {
+        return;
+    }
+    vk::RenderPassBeginInfo renderpassBeginInfo{};
+    renderpassBeginInfo.setRenderPass(*m_renderpass);
+    renderpassBeginInfo.setFramebuffer(
+        *m_framebuffers[imageIndex].getFramebuffer());
+    renderpassBeginInfo.setRenderArea(vk::Rect2D({0, 0}, extent));
+    buffer.beginRenderPass(renderpassBeginInfo, vk::SubpassContents::eInline);
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *buffer);
+    buffer.endRenderPass();
+}
+
+void Overlay::setDisplaySize(const vk::Extent2D& extent) noexcept {
+    m_displaySize = extent;
+}
+
+void Overlay::setVisible(bool visible) noexcept {
+    m_visible = visible;
+}
+
+bool Overlay::isVisible() const noexcept {
+    return m_visible;
+}
+} // namespace compound
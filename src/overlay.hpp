@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "init.hpp"
+#include "device.hpp"
+#include "swapchain.hpp"
+#include "framebuffer.hpp"
+#include "allocator.hpp"
+#include "commandencoder.hpp"
+#include "renderloop.hpp"
+#include "pipelinestatistics.hpp"
+#include <log4cplus/log4cplus.h>
+#include <array>
+#include <vector>
+
+namespace compound {
+// ImGui heads-up display drawn in its own pass on top of the swapchain image
+// after the main pass. It has framebuffers of its own over the swapchain
+// views since the main pass may add depth and multisampled attachments. No
+// platform backend is used
+// since GLFW may only be called from the main thread and the overlay is driven
+// from the render thread; it does not take input.
+class Overlay {
+public:
+    Overlay(const Init& init, const Device& device, const Swapchain& swapchain);
+    Overlay(const Overlay&) = delete;
+    Overlay& operator=(const Overlay&) = delete;
+    ~Overlay();
+    void update(const FrameTimings& timings,
+                const CommandEncoder::Statistics& statistics,
+                const Allocator* allocator = nullptr,
+                const PipelineStatistics* pipelineStatistics = nullptr);
+    void record(const vk::raii::CommandBuffer& buffer, uint32_t imageIndex,
+                const vk::Extent2D& extent) const;
+    void setDisplaySize(const vk::Extent2D& extent) noexcept;
+    void setVisible(bool visible) noexcept;
+    bool isVisible() const noexcept;
+
+private:
+    static constexpr size_t kHistorySize = 240;
+    struct History {
+        std::array<float, kHistorySize> values{};
+        size_t offset = 0;
+        void push(float value) noexcept;
+        float max() const noexcept;
+    };
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.overlay");
+    vk::raii::DescriptorPool m_descriptorPool;
+    vk::raii::RenderPass m_renderpass;
+    std::vector<Framebuffer> m_framebuffers;
+    vk::Extent2D m_displaySize;
+    bool m_visible = true;
+    History m_cpuFrame;
+    History m_fenceWait;
+    History m_acquire;
+    History m_present;
+    History m_gpu;
+    bool m_hasGpuTime = false;
+    void plot(const char* label, const History& history) const;
+};
+} // namespace compound
@@ -3,6 +3,7 @@
 #include <vulkan/vulkan_raii.hpp>
 #include "device.hpp"
 #include "swapchain.hpp"
+#include "pipelinestate.hpp"
 #include <log4cplus/log4cplus.h>
 
 namespace compound {
@@ -10,8 +11,15 @@ class Pipeline {
 public:
     Pipeline(const Device& device, const std::string& vertShaderPath,
              const std::string& fragShaderPath, vk::Format format);
+    // Depth testing is enabled when the render pass has a depth attachment.
+    Pipeline(const Device& device, const std::string& vertShaderPath,
+             const std::string& fragShaderPath,
+             const RenderPassState& renderPass);
+    Pipeline(const Device& device, const PipelineState& state);
     const vk::raii::RenderPass& getRenderpass() const noexcept;
     const vk::raii::Pipeline& getPipeline() const noexcept;
+    const vk::raii::PipelineLayout& getPipelineLayout() const noexcept;
+    const RenderPassState& getRenderPassState() const noexcept;
 
 private:
     log4cplus::Logger m_logger =
@@ -21,5 +29,6 @@ private:
     vk::raii::PipelineLayout m_pipelineLayout;
     vk::raii::RenderPass m_renderpass;
     vk::raii::Pipeline m_pipeline;
+    RenderPassState m_renderPassState;
 };
 } // namespace compound
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "pipelinecache.hpp"
+
+#include "utils.hpp"
+#include <array>
+#include <format>
+
+namespace compound {
+namespace {
+// Keeps only the parts of a state that a given library depends on, so that
+// variants differing elsewhere share the library.
+PipelineState maskState(const PipelineState& state,
+                        vk::GraphicsPipelineLibraryFlagBitsEXT part) {
+    PipelineState masked{};
+    switch (part) {
+        using enum vk::GraphicsPipelineLibraryFlagBitsEXT;
+        case eVertexInputInterface:
+            masked.topology = state.topology;
+            break;
+        case ePreRasterizationShaders:
+            masked.vertex = state.vertex;
+            masked.polygonMode = state.polygonMode;
+            masked.cullMode = state.cullMode;
+            masked.frontFace = state.frontFace;
+            masked.layout = state.layout;
+            masked.renderPass = state.renderPass;
+            break;
+        case eFragmentShader:
+            masked.fragment = state.fragment;
+            masked.depthTestEnable = state.depthTestEnable;
+            masked.depthWriteEnable = state.depthWriteEnable;
+            masked.depthCompareOp = state.depthCompareOp;
+            masked.layout = state.layout;
+            masked.renderPass = state.renderPass;
+            break;
+        case eFragmentOutputInterface:
+            masked.blendEnable = state.blendEnable;
+            masked.srcBlendFactor = state.srcBlendFactor;
+            masked.dstBlendFactor = state.dstBlendFactor;
+            masked.blendOp = state.blendOp;
+            masked.colorWriteMask = state.colorWriteMask;
+            masked.renderPass = state.renderPass;
+            break;
+    }
+    return masked;
+}
+} // namespace
+
+PipelineCache::Variant::Variant(vk::raii::Pipeline&& a_pipeline)
+    : pipeline(std::move(a_pipeline)),
+      handle(static_cast<VkPipeline>(*pipeline)) {
+}
+
+size_t PipelineCache::LibraryKeyHash::operator()(
+    const LibraryKey& key) const noexcept {
+    size_t seed = PipelineStateHash{}(key.state);
+    utils::hashCombine(seed, key.part);
+    return seed;
+}
+
+PipelineCache::PipelineCache(const Device& device)
+    : m_device(device), m_driverCache(0) {
+    vk::PipelineCacheCreateInfo createInfo{};
+    m_driverCache = device.getDevice().createPipelineCache(createInfo);
+    if (device.supportsGraphicsPipelineLibrary()) {
+        LOG4CPLUS_INFO(m_logger,
+                       "Fast-linking pipeline variants from libraries");
+    }
+}
+
+PipelineCache::~PipelineCache() {
+    // Queued optimizations still reference this cache, they return early.
+    m_stopping = true;
+    JobSystem::get().wait(m_optimizing);
+}
+
+vk::raii::Pipeline PipelineCache::compilePipeline(const PipelineState& state) {
+    auto& vertShaderModule = m_shaderModules.get(state.vertex.path, [&] {
+        return createShaderModule(m_device, state.vertex.path);
+    });
+    auto& fragShaderModule = m_shaderModules.get(state.fragment.path, [&] {
+        return createShaderModule(m_device, state.fragment.path);
+    });
+    return createGraphicsPipeline(
+        m_device, state, *vertShaderModule, *fragShaderModule,
+        getPipelineLayout(state.layout), getRenderPass(state.renderPass),
+        m_driverCache);
+}
+
+vk::Pipeline PipelineCache::getLibrary(
+    const PipelineState& state, vk::GraphicsPipelineLibraryFlagBitsEXT part) {
+    LibraryKey key{static_cast<VkGraphicsPipelineLibraryFlagsEXT>(part),
+                   maskState(state, part)};
+    return *m_libraries.get(key, [&] {
+        using enum vk::GraphicsPipelineLibraryFlagBitsEXT;
+        vk::ShaderModule vertShaderModule;
+        vk::ShaderModule fragShaderModule;
+        if (part == ePreRasterizationShaders) {
+            vertShaderModule = *m_shaderModules.get(state.vertex.path, [&] {
+                return createShaderModule(m_device, state.vertex.path);
+            });
+        }
+        if (part == eFragmentShader) {
+            fragShaderModule = *m_shaderModules.get(state.fragment.path, [&] {
+                return createShaderModule(m_device, state.fragment.path);
+            });
+        }
+        return createGraphicsPipelineLibrary(
+            m_device, key.state, part, vertShaderModule, fragShaderModule,
+            getPipelineLayout(state.layout), getRenderPass(state.renderPass),
+            m_driverCache);
+    });
+}
+
+vk::raii::Pipeline PipelineCache::linkPipeline(const PipelineState& state) {
+    using enum vk::GraphicsPipelineLibraryFlagBitsEXT;
+    std::array<vk::Pipeline, 4> libraries = {
+        getLibrary(state, eVertexInputInterface),
+        getLibrary(state, ePreRasterizationShaders),
+        getLibrary(state, eFragmentShader),
+        getLibrary(state, eFragmentOutputInterface)};
+    return linkGraphicsPipeline(m_device, libraries,
+                                getPipelineLayout(state.layout), false,
+                                m_driverCache);
+}
+
+vk::Pipeline PipelineCache::getPipeline(const PipelineState& state) {
+    const auto& variant = m_pipelines.get(state, [&] {
+        bool fastLink = m_device.supportsGraphicsPipelineLibrary();
+        LOG4CPLUS_INFO(m_logger,
+                       std::format("{} pipeline variant {} for {}",
+                                   fastLink ? "Linking" : "Compiling",
+                                   PipelineStateHash{}(state),
+                                   state.fragment.path));
+        auto variant = std::make_unique<Variant>(
+            fastLink ? linkPipeline(state) : compilePipeline(state));
+        if (fastLink && m_optimizeInBackground) {
+            JobSystem::get().run(
+                [this, state, target = variant.get()] {
+                    optimize(state, target);
+                },
+                &m_optimizing);
+        }
+        return variant;
+    });
+    return variant->handle.load(std::memory_order_acquire);
+}
+
+void PipelineCache::optimize(const PipelineState& state, Variant* variant) {
+    if (m_stopping) {
+        return;
+    }
+    try {
+        auto pipeline = compilePipeline(state);
+        std::lock_guard lock(m_optimizeMutex);
+        m_optimized.emplace_back(variant, std::move(pipeline));
+    } catch (std::exception& e) {
+        LOG4CPLUS_WARN(m_logger,
+                       std::format("Keeping fast-linked pipeline : {}",
+                                   e.what()));
+    }
+}
+
+size_t PipelineCache::promote(DeletionQueue& deletionQueue,
+                              uint64_t lastUsed) {
+    std::vector<std::pair<Variant*, vk::raii::Pipeline>> optimized;
+    {
+        std::lock_guard lock(m_optimizeMutex);
+        optimized.swap(m_optimized);
+    }
+    for (auto& [variant, pipeline] : optimized) {
+        std::swap(variant->pipeline, pipeline);
+        variant->handle.store(static_cast<VkPipeline>(*variant->pipeline),
+                              std::memory_order_release);
+        deletionQueue.retire(std::move(pipeline), lastUsed);
+    }
+    return optimized.size();
+}
+
+vk::RenderPass PipelineCache::getRenderPass(const RenderPassState& state) {
+    return *m_renderPasses.get(
+        state, [&] { return createRenderPass(m_device, state); });
+}
+
+vk::PipelineLayout PipelineCache::getPipelineLayout(
+    const PipelineLayoutState& state) {
+    return *m_pipelineLayouts.get(
+        state, [&] { return createPipelineLayout(m_device, state); });
+}
+
+void PipelineCache::prewarm(std::span<const PipelineState> states) {
+    LOG4CPLUS_INFO(m_logger,
+                   std::format("Prewarming {} pipeline variants", states.size()));
+    JobSystem::get().parallelFor(states.size(), 1, [&](size_t begin,
+                                                       size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            try {
+                getPipeline(states[i]);
+            } catch (std::exception& e) {
+                LOG4CPLUS_ERROR(m_logger,
+                                std::format("Failed to prewarm variant : {}",
+                                            e.what()));
+            }
+        }
+    });
+}
+
+size_t PipelineCache::getPipelineCount() const {
+    return m_pipelines.size();
+}
+
+void PipelineCache::setOptimizeInBackground(bool optimize) noexcept {
+    m_optimizeInBackground = optimize;
+}
+} // namespace compound
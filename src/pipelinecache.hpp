@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "pipelinestate.hpp"
+#include "deletionqueue.hpp"
+#include "jobsystem.hpp"
+#include <log4cplus/log4cplus.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace compound {
+// Returns graphics pipelines, render passes and layouts by value-described
+// state. Known keys are a shared-lock hash lookup; an unknown key is built
+// exactly once, with concurrent requests for it waiting on that build.
+//
+// When the device supports VK_EXT_graphics_pipeline_library, new variants
+// are fast-linked from separately cached vertex input, pre-rasterization,
+// fragment shader and fragment output libraries, and a fully optimized
+// pipeline is compiled on the job system. promote() swaps those in.
+class PipelineCache {
+public:
+    explicit PipelineCache(const Device& device);
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+    ~PipelineCache();
+    vk::Pipeline getPipeline(const PipelineState& state);
+    vk::RenderPass getRenderPass(const RenderPassState& state);
+    vk::PipelineLayout getPipelineLayout(const PipelineLayoutState& state);
+    void prewarm(std::span<const PipelineState> states);
+    size_t getPipelineCount() const;
+    void setOptimizeInBackground(bool optimize) noexcept;
+    size_t promote(DeletionQueue& deletionQueue, uint64_t lastUsed);
+
+private:
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class Table {
+    public:
+        template <typename Create>
+        const Value& get(const Key& key, Create&& create);
+        size_t size() const;
+
+    private:
+        struct Entry {
+            std::once_flag once;
+            std::optional<Value> value;
+        };
+        mutable std::shared_mutex m_mutex;
+        std::unordered_map<Key, std::unique_ptr<Entry>, Hash> m_entries;
+    };
+
+    struct Variant {
+        vk::raii::Pipeline pipeline;
+        std::atomic<VkPipeline> handle;
+        explicit Variant(vk::raii::Pipeline&& a_pipeline);
+    };
+
+    struct LibraryKey {
+        VkGraphicsPipelineLibraryFlagsEXT part;
+        PipelineState state;
+        bool operator==(const LibraryKey&) const = default;
+    };
+
+    struct LibraryKeyHash {
+        size_t operator()(const LibraryKey& key) const noexcept;
+    };
+
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.pipelinecache");
+    const Device& m_device;
+    vk::raii::PipelineCache m_driverCache;
+    Table<std::string, vk::raii::ShaderModule> m_shaderModules;
+    Table<RenderPassState, vk::raii::RenderPass, RenderPassStateHash>
+        m_renderPasses;
+    Table<PipelineLayoutState, vk::raii::PipelineLayout,
+          PipelineLayoutStateHash>
+        m_pipelineLayouts;
+    Table<LibraryKey, vk::raii::Pipeline, LibraryKeyHash> m_libraries;
+    Table<PipelineState, std::unique_ptr<Variant>, PipelineStateHash>
+        m_pipelines;
+
+    std::atomic<bool> m_optimizeInBackground = true;
+    std::atomic<bool> m_stopping = false;
+    JobSystem::Counter m_optimizing = 0;
+    std::mutex m_optimizeMutex;
+    std::vector<std::pair<Variant*, vk::raii::Pipeline>> m_optimized;
+
+    vk::raii::Pipeline compilePipeline(const PipelineState& state);
+    vk::raii::Pipeline linkPipeline(const PipelineState& state);
+    vk::Pipeline getLibrary(const PipelineState& state,
+                            vk::GraphicsPipelineLibraryFlagBitsEXT part);
+    void optimize(const PipelineState& state, Variant* variant);
+};
+
+template <typename Key, typename Value, typename Hash>
+template <typename Create>
+const Value& PipelineCache::Table<Key, Value, Hash>::get(const Key& key,
+                                                         Create&& create) {
+    Entry* entry = nullptr;
+    {
+        std::shared_lock lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            entry = it->second.get();
+        }
+    }
+    if (entry == nullptr) {
+        std::unique_lock lock(m_mutex);
+        auto& slot = m_entries[key];
+        if (!slot) {
+            slot = std::make_unique<Entry>();
+        }
+        entry = slot.get();
+    }
+    // Building happens outside the table lock so lookups of other keys never
+    // wait on a compile. A throwing build leaves the entry to be retried.
+    std::call_once(entry->once, [&] { entry->value.emplace(create()); });
+    return *entry->value;
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t PipelineCache::Table<Key, Value, Hash>::size() const {
+    std::shared_lock lock(m_mutex);
+    return m_entries.size();
+}
+} // namespace compound
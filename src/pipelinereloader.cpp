@@ -0,0 +1,122 @@
+#include "pipelinereloader.hpp"
+
+#include <format>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <vector>
+
+extern char** environ;
+
+namespace compound {
+namespace {
+// Runs a program found on PATH with the given arguments, without a shell
+// interpreting them, and returns whether it exited successfully.
+bool runProgram(std::vector<std::string> arguments) {
+    std::vector<char*> argv;
+    for (auto& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) !=
+        0) {
+        return false;
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid) {
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+} // namespace
+
+PipelineReloader::PipelineReloader(const Device& device,
+                                   const std::string& vertShaderPath,
+                                   const std::string& fragShaderPath,
+                                   vk::Format format)
+    : PipelineReloader(device, vertShaderPath, fragShaderPath,
+                       RenderPassState{.colorFormat = format}) {
+}
+
+PipelineReloader::PipelineReloader(const Device& device,
+                                   const std::string& vertShaderPath,
+                                   const std::string& fragShaderPath,
+                                   const RenderPassState& renderPass)
+    : m_device(device),
+      m_vertShaderPath(vertShaderPath),
+      m_fragShaderPath(fragShaderPath),
+      m_renderPass(renderPass),
+      m_pipeline(std::make_unique<Pipeline>(device, vertShaderPath,
+                                            fragShaderPath, renderPass)),
+      m_watcher([this](const std::filesystem::path& p) { onChange(p); }) {
+    m_watcher.watch(vertShaderPath);
+    m_watcher.watch(fragShaderPath);
+}
+
+void PipelineReloader::watchGlsl(const std::string& glslPath,
+                                 const std::string& spirvPath) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_glslOutputs[std::filesystem::absolute(glslPath).lexically_normal()] =
+            spirvPath;
+    }
+    m_watcher.watch(glslPath);
+}
+
+void PipelineReloader::setGlslCompiler(const std::string& compiler) {
+    std::lock_guard lock(m_mutex);
+    m_glslCompiler = compiler;
+}
+
+void PipelineReloader::onChange(const std::filesystem::path& path) {
+    std::vector<std::string> command;
+    {
+        std::lock_guard lock(m_mutex);
+        auto output = m_glslOutputs.find(path);
+        if (output != m_glslOutputs.end()) {
+            command = {m_glslCompiler, path.string(), "-o",
+                       output->second.string()};
+        }
+    }
+    if (!command.empty()) {
+        // The compiled SPIR-V is watched as well, writing it triggers the
+        // actual rebuild.
+        LOG4CPLUS_INFO(m_logger, "Compiling " + path.string());
+        if (!runProgram(std::move(command))) {
+            LOG4CPLUS_ERROR(m_logger, "Failed to compile " + path.string());
+        }
+        return;
+    }
+    LOG4CPLUS_INFO(m_logger, "Rebuilding pipeline");
+    try {
+        auto pipeline = std::make_unique<Pipeline>(
+            m_device, m_vertShaderPath, m_fragShaderPath, m_renderPass);
+        std::lock_guard lock(m_mutex);
+        m_pending = std::move(pipeline);
+    } catch (std::exception& e) {
+        LOG4CPLUS_ERROR(m_logger,
+                        std::format("Keeping previous pipeline : {}",
+                                    e.what()));
+    }
+}
+
+bool PipelineReloader::update(DeletionQueue& deletionQueue,
+                              uint64_t lastUsed) {
+    std::unique_ptr<Pipeline> pending;
+    {
+        std::lock_guard lock(m_mutex);
+        pending = std::move(m_pending);
+    }
+    if (!pending) {
+        return false;
+    }
+    LOG4CPLUS_INFO(m_logger, "Swapping in rebuilt pipeline");
+    std::swap(m_pipeline, pending);
+    deletionQueue.retire(std::move(pending), lastUsed);
+    return true;
+}
+
+const Pipeline& PipelineReloader::getPipeline() const noexcept {
+    return *m_pipeline;
+}
+} // namespace compound
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "device.hpp"
+#include "pipeline.hpp"
+#include "deletionqueue.hpp"
+#include "shaderwatcher.hpp"
+#include <log4cplus/log4cplus.h>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace compound {
+// Rebuilds a Pipeline in the background whenever one of its shaders changes
+// on disk. The rebuilt pipeline only becomes visible through getPipeline()
+// after update(), which is meant to be called between frames.
+class PipelineReloader {
+public:
+    PipelineReloader(const Device& device, const std::string& vertShaderPath,
+                     const std::string& fragShaderPath, vk::Format format);
+    PipelineReloader(const Device& device, const std::string& vertShaderPath,
+                     const std::string& fragShaderPath,
+                     const RenderPassState& renderPass);
+    void watchGlsl(const std::string& glslPath, const std::string& spirvPath);
+    void setGlslCompiler(const std::string& compiler);
+    bool update(DeletionQueue& deletionQueue, uint64_t lastUsed);
+    const Pipeline& getPipeline() const noexcept;
+
+private:
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.pipelinereloader");
+    const Device& m_device;
+    std::string m_vertShaderPath;
+    std::string m_fragShaderPath;
+    RenderPassState m_renderPass;
+    std::unique_ptr<Pipeline> m_pipeline;
+    std::mutex m_mutex;
+    std::unique_ptr<Pipeline> m_pending;
+    std::string m_glslCompiler = "glslc";
+    std::map<std::filesystem::path, std::filesystem::path> m_glslOutputs;
+    ShaderWatcher m_watcher;
+    void onChange(const std::filesystem::path& path);
+};
+} // namespace compound
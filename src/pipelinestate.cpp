@@ -0,0 +1,424 @@
+#include "pipelinestate.hpp"
+
+#include "utils.hpp"
+#include <array>
+
+namespace compound {
+namespace {
+template <typename T>
+size_t enumHash(T value) {
+    return std::hash<uint64_t>{}(static_cast<uint64_t>(value));
+}
+
+void hashStage(size_t& seed, const ShaderStageState& stage) {
+    utils::hashCombine(seed, stage.path);
+    for (const auto& constant : stage.specialization) {
+        utils::hashCombine(seed, constant.id);
+        utils::hashCombine(seed, constant.value);
+    }
+}
+
+struct Specialization {
+    std::vector<vk::SpecializationMapEntry> entries;
+    std::vector<uint32_t> data;
+    vk::SpecializationInfo info;
+    explicit Specialization(const ShaderStageState& stage) {
+        for (const auto& constant : stage.specialization) {
+            entries.emplace_back(constant.id,
+                                 data.size() * sizeof(uint32_t),
+                                 sizeof(uint32_t));
+            data.push_back(constant.value);
+        }
+        info.setMapEntries(entries);
+        info.setData<uint32_t>(data);
+    }
+};
+constexpr vk::GraphicsPipelineLibraryFlagsEXT kAllLibraryParts =
+    vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface |
+    vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders |
+    vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader |
+    vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface;
+
+// All create-info structures of a graphics pipeline, kept alive together so
+// that either the full pipeline or any library subset can point into them.
+struct PipelineDescription {
+    Specialization vertSpecialization;
+    Specialization fragSpecialization;
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages;
+    vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
+    vk::PipelineInputAssemblyStateCreateInfo
+        vertexInputAssemblyStateCreateInfo{};
+    std::array<vk::DynamicState, 2> dynamicStates = {
+        vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+    vk::PipelineViewportStateCreateInfo viewportStateCreateInfo{};
+    vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
+    vk::PipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
+    vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+    vk::PipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
+    vk::PipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
+    vk::PipelineLayout layout;
+    vk::RenderPass renderpass;
+
+    PipelineDescription(const PipelineState& state,
+                        vk::ShaderModule vertShaderModule,
+                        vk::ShaderModule fragShaderModule,
+                        vk::PipelineLayout a_layout,
+                        vk::RenderPass a_renderpass)
+        : vertSpecialization(state.vertex),
+          fragSpecialization(state.fragment),
+          layout(a_layout),
+          renderpass(a_renderpass) {
+        auto& vertShaderStageCreateInfo = stages[0];
+        vertShaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eVertex);
+        vertShaderStageCreateInfo.setModule(vertShaderModule);
+        vertShaderStageCreateInfo.setPName("main");
+        vertShaderStageCreateInfo.setPSpecializationInfo(
+            &vertSpecialization.info);
+
+        auto& fragShaderStageCreateInfo = stages[1];
+        fragShaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eFragment);
+        fragShaderStageCreateInfo.setModule(fragShaderModule);
+        fragShaderStageCreateInfo.setPName("main");
+        fragShaderStageCreateInfo.setPSpecializationInfo(
+            &fragSpecialization.info);
+
+        vertexInputAssemblyStateCreateInfo.setTopology(state.topology);
+        vertexInputAssemblyStateCreateInfo.setPrimitiveRestartEnable(
+            vk::False);
+
+        dynamicStateCreateInfo.setDynamicStates(dynamicStates);
+
+        viewportStateCreateInfo.setScissorCount(1);
+        viewportStateCreateInfo.setViewportCount(1);
+
+        rasterizationStateCreateInfo.setDepthClampEnable(vk::False);
+        rasterizationStateCreateInfo.setRasterizerDiscardEnable(vk::False);
+        rasterizationStateCreateInfo.setPolygonMode(state.polygonMode);
+        rasterizationStateCreateInfo.setLineWidth(1.0f);
+        rasterizationStateCreateInfo.setCullMode(state.cullMode);
+        rasterizationStateCreateInfo.setFrontFace(state.frontFace);
+        rasterizationStateCreateInfo.setDepthBiasEnable(vk::False);
+        rasterizationStateCreateInfo.setDepthBiasConstantFactor(0.0f);
+        rasterizationStateCreateInfo.setDepthBiasClamp(0.0f);
+        rasterizationStateCreateInfo.setDepthBiasSlopeFactor(0.0f);
+
+        multisampleStateCreateInfo.setSampleShadingEnable(vk::False);
+        multisampleStateCreateInfo.setRasterizationSamples(
+            state.renderPass.samples);
+        multisampleStateCreateInfo.setMinSampleShading(1.0f);
+        multisampleStateCreateInfo.setPSampleMask(nullptr);
+        multisampleStateCreateInfo.setAlphaToCoverageEnable(vk::False);
+        multisampleStateCreateInfo.setAlphaToOneEnable(vk::False);
+
+        colorBlendAttachment.setColorWriteMask(state.colorWriteMask);
+        colorBlendAttachment.setBlendEnable(state.blendEnable);
+        colorBlendAttachment.setSrcColorBlendFactor(state.srcBlendFactor);
+        colorBlendAttachment.setDstColorBlendFactor(state.dstBlendFactor);
+        colorBlendAttachment.setColorBlendOp(state.blendOp);
+        colorBlendAttachment.setSrcAlphaBlendFactor(vk::BlendFactor::eOne);
+        colorBlendAttachment.setDstAlphaBlendFactor(vk::BlendFactor::eZero);
+        colorBlendAttachment.setAlphaBlendOp(vk::BlendOp::eAdd);
+
+        colorBlendStateCreateInfo.setLogicOpEnable(vk::False);
+        colorBlendStateCreateInfo.setLogicOp(vk::LogicOp::eCopy);
+        colorBlendStateCreateInfo.setAttachments(colorBlendAttachment);
+
+        depthStencilStateCreateInfo.setDepthTestEnable(state.depthTestEnable);
+        depthStencilStateCreateInfo.setDepthWriteEnable(
+            state.depthWriteEnable);
+        depthStencilStateCreateInfo.setDepthCompareOp(state.depthCompareOp);
+        depthStencilStateCreateInfo.setDepthBoundsTestEnable(vk::False);
+        depthStencilStateCreateInfo.setStencilTestEnable(vk::False);
+    }
+
+    PipelineDescription(const PipelineDescription&) = delete;
+    PipelineDescription& operator=(const PipelineDescription&) = delete;
+
+    // Points the create info at the state belonging to the requested
+    // graphics pipeline library parts, a full pipeline uses all of them.
+    void fill(vk::GraphicsPipelineCreateInfo& createInfo,
+              vk::GraphicsPipelineLibraryFlagsEXT parts) const {
+        using enum vk::GraphicsPipelineLibraryFlagBitsEXT;
+        bool vertexInput = bool(parts & eVertexInputInterface);
+        bool preRasterization = bool(parts & ePreRasterizationShaders);
+        bool fragmentShader = bool(parts & eFragmentShader);
+        bool fragmentOutput = bool(parts & eFragmentOutputInterface);
+        uint32_t firstStage = preRasterization ? 0 : 1;
+        uint32_t stageCount =
+            (preRasterization ? 1 : 0) + (fragmentShader ? 1 : 0);
+        createInfo.setStageCount(stageCount);
+        createInfo.setPStages(stageCount > 0 ? &stages[firstStage] : nullptr);
+        if (vertexInput) {
+            createInfo.setPVertexInputState(&vertexInputStateCreateInfo);
+            createInfo.setPInputAssemblyState(
+                &vertexInputAssemblyStateCreateInfo);
+        }
+        if (preRasterization) {
+            createInfo.setPViewportState(&viewportStateCreateInfo);
+            createInfo.setPRasterizationState(&rasterizationStateCreateInfo);
+            createInfo.setPDynamicState(&dynamicStateCreateInfo);
+        }
+        if (fragmentShader || fragmentOutput) {
+            createInfo.setPMultisampleState(&multisampleStateCreateInfo);
+        }
+        if (fragmentOutput) {
+            createInfo.setPColorBlendState(&colorBlendStateCreateInfo);
+        }
+        createInfo.setPDepthStencilState(
+            fragmentShader ? &depthStencilStateCreateInfo : nullptr);
+        if (preRasterization || fragmentShader) {
+            createInfo.setLayout(layout);
+        }
+        createInfo.setRenderPass(renderpass);
+        createInfo.setSubpass(0);
+        createInfo.setBasePipelineHandle(nullptr);
+        createInfo.setBasePipelineIndex(-1);
+    }
+};
+} // namespace
+
+size_t RenderPassStateHash::operator()(
+    const RenderPassState& state) const noexcept {
+    size_t seed = enumHash(state.colorFormat);
+    utils::hashCombine(seed, enumHash(state.depthFormat));
+    utils::hashCombine(seed, enumHash(state.samples));
+    utils::hashCombine(seed, enumHash(state.colorLoadOp));
+    utils::hashCombine(seed, enumHash(state.finalLayout));
+    return seed;
+}
+
+size_t PipelineLayoutStateHash::operator()(
+    const PipelineLayoutState& state) const noexcept {
+    size_t seed = 0;
+    for (const auto& setLayout : state.setLayouts) {
+        utils::hashCombine(seed,
+                           static_cast<VkDescriptorSetLayout>(setLayout));
+    }
+    for (const auto& range : state.pushConstantRanges) {
+        utils::hashCombine(seed, static_cast<VkShaderStageFlags>(
+                                     range.stageFlags));
+        utils::hashCombine(seed, range.offset);
+        utils::hashCombine(seed, range.size);
+    }
+    return seed;
+}
+
+size_t PipelineStateHash::operator()(
+    const PipelineState& state) const noexcept {
+    size_t seed = 0;
+    hashStage(seed, state.vertex);
+    hashStage(seed, state.fragment);
+    utils::hashCombine(seed, enumHash(state.topology));
+    utils::hashCombine(seed, enumHash(state.polygonMode));
+    utils::hashCombine(seed,
+                       static_cast<VkCullModeFlags>(state.cullMode));
+    utils::hashCombine(seed, enumHash(state.frontFace));
+    utils::hashCombine(seed, state.blendEnable);
+    utils::hashCombine(seed, enumHash(state.srcBlendFactor));
+    utils::hashCombine(seed, enumHash(state.dstBlendFactor));
+    utils::hashCombine(seed, enumHash(state.blendOp));
+    utils::hashCombine(seed, static_cast<VkColorComponentFlags>(
+                                 state.colorWriteMask));
+    utils::hashCombine(seed, state.depthTestEnable);
+    utils::hashCombine(seed, state.depthWriteEnable);
+    utils::hashCombine(seed, enumHash(state.depthCompareOp));
+    utils::hashCombine(seed, RenderPassStateHash{}(state.renderPass));
+    utils::hashCombine(seed, PipelineLayoutStateHash{}(state.layout));
+    return seed;
+}
+
+vk::raii::ShaderModule createShaderModule(const Device& device,
+                                          const std::string& path) {
+    auto code = utils::readFile(path);
+    vk::ShaderModuleCreateInfo shaderModuleCreateInfo{};
+    const uint32_t* arr = reinterpret_cast<const uint32_t*>(code.data());
+    shaderModuleCreateInfo.setCode(*arr);
+    shaderModuleCreateInfo.setCodeSize(code.size());
+    return device.getDevice().createShaderModule(shaderModuleCreateInfo);
+}
+
+vk::raii::RenderPass createRenderPass(const Device& device,
+                                      const RenderPassState& state) {
+    bool multisampled = state.samples != vk::SampleCountFlagBits::e1;
+    bool depth = state.depthFormat != vk::Format::eUndefined;
+    if (multisampled && state.colorLoadOp == vk::AttachmentLoadOp::eLoad) {
+        throw std::runtime_error(
+            "A multisampled render pass cannot load its color attachment");
+    }
+    std::vector<vk::AttachmentDescription> attachments;
+
+    vk::AttachmentDescription colorAttachment{};
+    colorAttachment.setFormat(state.colorFormat);
+    colorAttachment.setSamples(vk::SampleCountFlagBits::e1);
+    // A resolve overwrites every pixel.
+    colorAttachment.setLoadOp(multisampled ? vk::AttachmentLoadOp::eDontCare
+                                           : state.colorLoadOp);
+    colorAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
+    colorAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+    colorAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+    colorAttachment.setInitialLayout(
+        state.colorLoadOp == vk::AttachmentLoadOp::eLoad
+            ? state.finalLayout
+            : vk::ImageLayout::eUndefined);
+    colorAttachment.setFinalLayout(state.finalLayout);
+    attachments.push_back(colorAttachment);
+
+    vk::AttachmentReference attachmentReference{};
+    attachmentReference.setAttachment(0);
+    attachmentReference.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
+    vk::AttachmentReference multisampledReference{};
+    vk::AttachmentReference depthReference{};
+
+    // Multisampled color and depth only live within the pass: cleared on
+    // load and never stored, so tiled GPUs keep them in tile memory.
+    if (multisampled) {
+        vk::AttachmentDescription multisampledAttachment{};
+        multisampledAttachment.setFormat(state.colorFormat);
+        multisampledAttachment.setSamples(state.samples);
+        multisampledAttachment.setLoadOp(state.colorLoadOp);
+        multisampledAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+        multisampledAttachment.setStencilLoadOp(
+            vk::AttachmentLoadOp::eDontCare);
+        multisampledAttachment.setStencilStoreOp(
+            vk::AttachmentStoreOp::eDontCare);
+        multisampledAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
+        multisampledAttachment.setFinalLayout(
+            vk::ImageLayout::eColorAttachmentOptimal);
+        multisampledReference.setAttachment(attachments.size());
+        multisampledReference.setLayout(
+            vk::ImageLayout::eColorAttachmentOptimal);
+        attachments.push_back(multisampledAttachment);
+    }
+    if (depth) {
+        vk::AttachmentDescription depthAttachment{};
+        depthAttachment.setFormat(state.depthFormat);
+        depthAttachment.setSamples(state.samples);
+        depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
+        depthAttachment.setStoreOp(vk::AttachmentStoreOp::eDontCare);
+        depthAttachment.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+        depthAttachment.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+        depthAttachment.setInitialLayout(vk::ImageLayout::eUndefined);
+        depthAttachment.setFinalLayout(
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        depthReference.setAttachment(attachments.size());
+        depthReference.setLayout(
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        attachments.push_back(depthAttachment);
+    }
+
+    vk::SubpassDescription subpassDescription{};
+    subpassDescription.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+    if (multisampled) {
+        subpassDescription.setColorAttachments(multisampledReference);
+        subpassDescription.setResolveAttachments(attachmentReference);
+    } else {
+        subpassDescription.setColorAttachments(attachmentReference);
+    }
+    if (depth) {
+        subpassDescription.setPDepthStencilAttachment(&depthReference);
+    }
+
+    vk::SubpassDependency subpassDependency{};
+    subpassDependency.srcSubpass = vk::SubpassExternal;
+    subpassDependency.dstSubpass = 0;
+    subpassDependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    // Identical for every load op so that passes stay compatible; a pass
+    // loading the attachment must see writes of the pass before it.
+    subpassDependency.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+    subpassDependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    subpassDependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead |
+                                      vk::AccessFlagBits::eColorAttachmentWrite;
+    if (depth) {
+        // The depth attachment is shared by consecutive frames, so its clear
+        // has to wait for the previous frame's depth tests.
+        subpassDependency.srcStageMask |=
+            vk::PipelineStageFlagBits::eLateFragmentTests;
+        subpassDependency.srcAccessMask |=
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        subpassDependency.dstStageMask |=
+            vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        subpassDependency.dstAccessMask |=
+            vk::AccessFlagBits::eDepthStencilAttachmentRead |
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    }
+
+    vk::RenderPassCreateInfo renderpassCreateInfo{};
+    renderpassCreateInfo.setAttachments(attachments);
+    renderpassCreateInfo.setSubpasses(subpassDescription);
+    renderpassCreateInfo.setDependencies(subpassDependency);
+    return device.getDevice().createRenderPass(renderpassCreateInfo);
+}
+
+std::vector<vk::ClearValue> getClearValues(const RenderPassState& state,
+                                           const vk::ClearColorValue& color,
+                                           float depth) {
+    std::vector<vk::ClearValue> clearValues = {color};
+    if (state.samples != vk::SampleCountFlagBits::e1) {
+        clearValues.emplace_back(color);
+    }
+    if (state.depthFormat != vk::Format::eUndefined) {
+        clearValues.emplace_back(vk::ClearDepthStencilValue(depth, 0));
+    }
+    return clearValues;
+}
+
+vk::raii::PipelineLayout createPipelineLayout(
+    const Device& device, const PipelineLayoutState& state) {
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.setSetLayouts(state.setLayouts);
+    pipelineLayoutCreateInfo.setPushConstantRanges(state.pushConstantRanges);
+    return device.getDevice().createPipelineLayout(pipelineLayoutCreateInfo);
+}
+
+vk::raii::Pipeline createGraphicsPipeline(
+    const Device& device, const PipelineState& state,
+    vk::ShaderModule vertShaderModule, vk::ShaderModule fragShaderModule,
+    vk::PipelineLayout layout, vk::RenderPass renderpass,
+    vk::Optional<const vk::raii::PipelineCache> cache) {
+    PipelineDescription description(state, vertShaderModule,
+                                    fragShaderModule, layout, renderpass);
+    vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    description.fill(graphicsPipelineCreateInfo, kAllLibraryParts);
+    return device.getDevice().createGraphicsPipeline(
+        cache, graphicsPipelineCreateInfo);
+}
+
+vk::raii::Pipeline createGraphicsPipelineLibrary(
+    const Device& device, const PipelineState& state,
+    vk::GraphicsPipelineLibraryFlagsEXT parts,
+    vk::ShaderModule vertShaderModule, vk::ShaderModule fragShaderModule,
+    vk::PipelineLayout layout, vk::RenderPass renderpass,
+    vk::Optional<const vk::raii::PipelineCache> cache) {
+    PipelineDescription description(state, vertShaderModule,
+                                    fragShaderModule, layout, renderpass);
+    vk::GraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo{};
+    libraryCreateInfo.setFlags(parts);
+    vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    description.fill(graphicsPipelineCreateInfo, parts);
+    graphicsPipelineCreateInfo.setFlags(
+        vk::PipelineCreateFlagBits::eLibraryKHR |
+        vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT);
+    graphicsPipelineCreateInfo.setPNext(&libraryCreateInfo);
+    return device.getDevice().createGraphicsPipeline(
+        cache, graphicsPipelineCreateInfo);
+}
+
+vk::raii::Pipeline linkGraphicsPipeline(
+    const Device& device, vk::ArrayProxy<const vk::Pipeline> libraries,
+    vk::PipelineLayout layout, bool optimize,
+    vk::Optional<const vk::raii::PipelineCache> cache) {
+    vk::PipelineLibraryCreateInfoKHR libraryCreateInfo{};
+    libraryCreateInfo.setLibraryCount(libraries.size());
+    libraryCreateInfo.setPLibraries(libraries.data());
+    vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    graphicsPipelineCreateInfo.setPNext(&libraryCreateInfo);
+    graphicsPipelineCreateInfo.setLayout(layout);
+    if (optimize) {
+        graphicsPipelineCreateInfo.setFlags(
+            vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT);
+    }
+    return device.getDevice().createGraphicsPipeline(
+        cache, graphicsPipelineCreateInfo);
+}
+} // namespace compound
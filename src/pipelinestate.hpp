@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compound {
+struct SpecializationConstant {
+    uint32_t id;
+    uint32_t value;
+    bool operator==(const SpecializationConstant&) const = default;
+};
+
+struct ShaderStageState {
+    std::string path;
+    std::vector<SpecializationConstant> specialization;
+    bool operator==(const ShaderStageState&) const = default;
+};
+
+// Attachments, in framebuffer order: the single-sampled color attachment
+// the pass leaves behind, a multisampled color attachment resolved into it
+// when samples is above one, and a depth attachment when depthFormat is set.
+// Everything but the first is discarded at the end of the pass.
+struct RenderPassState {
+    vk::Format colorFormat = vk::Format::eUndefined;
+    vk::Format depthFormat = vk::Format::eUndefined;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+    vk::AttachmentLoadOp colorLoadOp = vk::AttachmentLoadOp::eClear;
+    vk::ImageLayout finalLayout = vk::ImageLayout::ePresentSrcKHR;
+    bool operator==(const RenderPassState&) const = default;
+};
+
+struct PipelineLayoutState {
+    std::vector<vk::DescriptorSetLayout> setLayouts;
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    bool operator==(const PipelineLayoutState&) const = default;
+};
+
+// Everything that goes into a graphics pipeline, in a form that can be
+// compared and hashed. Defaults match the original hardcoded Pipeline.
+struct PipelineState {
+    ShaderStageState vertex;
+    ShaderStageState fragment;
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+    vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+    vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+    vk::FrontFace frontFace = vk::FrontFace::eClockwise;
+    bool blendEnable = false;
+    vk::BlendFactor srcBlendFactor = vk::BlendFactor::eSrcAlpha;
+    vk::BlendFactor dstBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+    vk::BlendOp blendOp = vk::BlendOp::eAdd;
+    vk::ColorComponentFlags colorWriteMask =
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+        vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+    // Only take effect when the render pass has a depth attachment.
+    bool depthTestEnable = false;
+    bool depthWriteEnable = false;
+    vk::CompareOp depthCompareOp = vk::CompareOp::eLessOrEqual;
+    RenderPassState renderPass;
+    PipelineLayoutState layout;
+    bool operator==(const PipelineState&) const = default;
+};
+
+struct RenderPassStateHash {
+    size_t operator()(const RenderPassState& state) const noexcept;
+};
+
+struct PipelineLayoutStateHash {
+    size_t operator()(const PipelineLayoutState& state) const noexcept;
+};
+
+struct PipelineStateHash {
+    size_t operator()(const PipelineState& state) const noexcept;
+};
+
+vk::raii::ShaderModule createShaderModule(const Device& device,
+                                          const std::string& path);
+vk::raii::RenderPass createRenderPass(const Device& device,
+                                      const RenderPassState& state);
+// One clear value per attachment of the pass.
+std::vector<vk::ClearValue> getClearValues(const RenderPassState& state,
+                                           const vk::ClearColorValue& color,
+                                           float depth = 1.0f);
+vk::raii::PipelineLayout createPipelineLayout(const Device& device,
+                                              const PipelineLayoutState& state);
+vk::raii::Pipeline createGraphicsPipeline(
+    const Device& device, const PipelineState& state,
+    vk::ShaderModule vertShaderModule, vk::ShaderModule fragShaderModule,
+    vk::PipelineLayout layout, vk::RenderPass renderpass,
+    vk::Optional<const vk::raii::PipelineCache> cache = nullptr);
+vk::raii::Pipeline createGraphicsPipelineLibrary(
+    const Device& device, const PipelineState& state,
+    vk::GraphicsPipelineLibraryFlagsEXT parts,
+    vk::ShaderModule vertShaderModule, vk::ShaderModule fragShaderModule,
+    vk::PipelineLayout layout, vk::RenderPass renderpass,
+    vk::Optional<const vk::raii::PipelineCache> cache = nullptr);
+vk::raii::Pipeline linkGraphicsPipeline(
+    const Device& device, vk::ArrayProxy<const vk::Pipeline> libraries,
+    vk::PipelineLayout layout, bool optimize,
+    vk::Optional<const vk::raii::PipelineCache> cache = nullptr);
+} // namespace compound
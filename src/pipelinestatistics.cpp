@@ -0,0 +1,82 @@
+#include "pipelinestatistics.hpp"
+
+namespace compound {
+PipelineStatistics::PipelineStatistics(const Device& device,
+                                       uint32_t maxScopes)
+    : m_queryPool(0),
+      m_maxScopes(maxScopes),
+      m_supported(device.supportsPipelineStatistics()) {
+    if (!m_supported) {
+        LOG4CPLUS_WARN(m_logger, "Pipeline statistics queries unsupported");
+        return;
+    }
+    // Results come back in bit order of the flags.
+    using enum vk::QueryPipelineStatisticFlagBits;
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.setQueryType(vk::QueryType::ePipelineStatistics);
+    createInfo.setQueryCount(maxScopes);
+    createInfo.setPipelineStatistics(
+        eInputAssemblyVertices | eInputAssemblyPrimitives |
+        eVertexShaderInvocations | eClippingInvocations | eClippingPrimitives |
+        eFragmentShaderInvocations);
+    m_queryPool = device.getDevice().createQueryPool(createInfo);
+}
+
+void PipelineStatistics::reset(const vk::raii::CommandBuffer& buffer) {
+    if (!m_supported) {
+        return;
+    }
+    buffer.resetQueryPool(*m_queryPool, 0, m_maxScopes);
+    m_recorded.clear();
+}
+
+void PipelineStatistics::begin(const vk::raii::CommandBuffer& buffer,
+                               const std::string& name) {
+    if (!m_supported) {
+        return;
+    }
+    if (m_recorded.size() >= m_maxScopes) {
+        LOG4CPLUS_ERROR(m_logger, "Too many pipeline statistics scopes");
+        throw std::runtime_error("Too many pipeline statistics scopes");
+    }
+    buffer.beginQuery(*m_queryPool, m_recorded.size(), {});
+    m_recorded.push_back(name);
+}
+
+void PipelineStatistics::end(const vk::raii::CommandBuffer& buffer) {
+    if (!m_supported || m_recorded.empty()) {
+        return;
+    }
+    buffer.endQuery(*m_queryPool, m_recorded.size() - 1);
+}
+
+bool PipelineStatistics::resolve() {
+    if (!m_supported || m_recorded.empty()) {
+        return false;
+    }
+    uint32_t count = m_recorded.size();
+    auto [result, values] = m_queryPool.getResults<uint64_t>(
+        0, count, count * kCounterCount * sizeof(uint64_t),
+        kCounterCount * sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return false;
+    }
+    m_scopes.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint64_t* counters = &values[i * kCounterCount];
+        m_scopes[i] = {m_recorded[i],
+                       {counters[0], counters[1], counters[2], counters[3],
+                        counters[4], counters[5]}};
+    }
+    return true;
+}
+
+const std::vector<PipelineStatistics::Scope>& PipelineStatistics::getScopes()
+    const noexcept {
+    return m_scopes;
+}
+
+bool PipelineStatistics::isSupported() const noexcept {
+    return m_supported;
+}
+} // namespace compound
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include <log4cplus/log4cplus.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compound {
+// Pipeline statistics queries around named scopes of a frame, typically one
+// per pass. Scopes cannot nest. Like GpuTimer, results are fetched without
+// waiting, so resolve() reports the last frame whose fence has been waited
+// on. Does nothing when the device lacks pipelineStatisticsQuery.
+class PipelineStatistics {
+public:
+    struct Counters {
+        uint64_t inputAssemblyVertices = 0;
+        uint64_t inputAssemblyPrimitives = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t clippingInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentShaderInvocations = 0;
+    };
+    struct Scope {
+        std::string name;
+        Counters counters;
+    };
+
+    explicit PipelineStatistics(const Device& device, uint32_t maxScopes = 8);
+    // Outside of a render pass, before the frame's first scope.
+    void reset(const vk::raii::CommandBuffer& buffer);
+    void begin(const vk::raii::CommandBuffer& buffer, const std::string& name);
+    void end(const vk::raii::CommandBuffer& buffer);
+    bool resolve();
+    const std::vector<Scope>& getScopes() const noexcept;
+    bool isSupported() const noexcept;
+
+private:
+    static constexpr uint32_t kCounterCount = 6;
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.pipelinestatistics");
+    vk::raii::QueryPool m_queryPool;
+    uint32_t m_maxScopes;
+    bool m_supported;
+    std::vector<std::string> m_recorded;
+    std::vector<Scope> m_scopes;
+};
+} // namespace compound
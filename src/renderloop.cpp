@@ -1,9 +1,28 @@
 #include "renderloop.hpp"
 
+#include "defragmenter.hpp"
+#include "framecapture.hpp"
+#include "occlusionqueries.hpp"
+#include "pipelinestatistics.hpp"
+#include "texturestreamer.hpp"
+#include <log4cplus/loggingmacros.h>
+#include <algorithm>
+#include <format>
+
 namespace compound {
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
 Renderloop::Renderloop(const Device& a_device,
                        const std::vector<Framebuffer>& a_framebuffers)
-    : m_imageAvailable(0), m_inFlight(0) {
+    : m_imageAvailable(0),
+      m_inFlight(0),
+      m_gpuTimer(a_device),
+      m_lastFrameStart(std::chrono::steady_clock::now()),
+      m_submitter(a_device) {
     vk::SemaphoreCreateInfo semaphoreCreateInfo{};
     vk::FenceCreateInfo fenceCreateInfo{};
     fenceCreateInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
@@ -16,40 +35,156 @@ Renderloop::Renderloop(const Device& a_device,
     }
 }
 
+uint32_t Renderloop::acquire(const Swapchain& swapchain,
+                             const vk::raii::Semaphore& semaphore) {
+    auto result = swapchain.getSwapchain().acquireNextImage(
+        std::numeric_limits<uint64_t>::max(), *semaphore, nullptr);
+    if (result.first != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to acquire next image from swapchain");
+    }
+    return result.second;
+}
+
 void Renderloop::drawFrame(const Device& a_device,
                            const std::vector<Framebuffer>& a_framebuffers,
                            const CommandBuffer& a_commandBuffer,
                            const Swapchain& a_swapchain,
-                           const Pipeline& a_pipeline) {
+                           const Pipeline& a_pipeline,
+                           const RecordOptions& a_options) {
+    auto frameStart = std::chrono::steady_clock::now();
+    m_timings.cpuFrame = std::chrono::duration<double, std::milli>(
+                             frameStart - m_lastFrameStart)
+                             .count();
+    m_lastFrameStart = frameStart;
+    // The fence of the last frame can only be waited on once the submission
+    // thread passed it to the queue.
+    m_submitter.waitSubmitted(m_lastSubmission);
     [[maybe_unused]] vk::Result result1 = a_device.getDevice().waitForFences(
         *m_inFlight, vk::True, std::numeric_limits<uint64_t>::max());
+    m_timings.fenceWait = millisecondsSince(frameStart);
+    m_timings.gpu = m_gpuTimer.resolve();
+    if (a_options.pipelineStatistics) {
+        a_options.pipelineStatistics->resolve();
+    }
+    if (a_options.occlusion) {
+        a_options.occlusion->queries->collect();
+    }
     a_device.getDevice().resetFences(*m_inFlight);
-    uint32_t imageIndex;
-    auto result = a_swapchain.getSwapchain().acquireNextImage(
-        std::numeric_limits<uint64_t>::max(), *m_imageAvailable, nullptr);
-    if (result.first == vk::Result::eSuccess) {
-        imageIndex = result.second;
-    } else {
-        throw std::runtime_error("Failed to acquire next image from swapchain");
+    // Only one frame is in flight, so every frame submitted so far is done.
+    m_completedFrame = m_currentFrame;
+    m_deletionQueue.collect(m_completedFrame);
+    if (a_options.capture) {
+        a_options.capture->collect(m_completedFrame);
+    }
+    if (a_options.textures) {
+        a_options.textures->collect(m_completedFrame);
+    }
+    if (a_options.defragmenter) {
+        a_options.defragmenter->collect(m_completedFrame);
     }
+    m_currentFrame++;
+    auto acquireStart = std::chrono::steady_clock::now();
+    // Acquiring may block until an image was presented, so the presents of
+    // the last frame have to be issued first. Usually they were long ago.
+    m_submitter.waitPresented(m_lastSubmission);
+    uint32_t imageIndex = acquire(a_swapchain, m_imageAvailable);
+    m_targetRecords.clear();
+    for (auto& target : m_targets) {
+        target.imageIndex = acquire(*target.swapchain, target.imageAvailable);
+        m_targetRecords.push_back(
+            {target.swapchain, &(*target.framebuffers)[target.imageIndex]});
+    }
+    m_timings.acquire = millisecondsSince(acquireStart);
+    RecordOptions options = a_options;
+    options.gpuTimer = &m_gpuTimer;
+    options.targets = m_targetRecords;
+    options.imageIndex = imageIndex;
+    options.frame = m_currentFrame;
     a_commandBuffer.getBuffer().reset();
-    a_commandBuffer.record(a_swapchain, a_pipeline, a_framebuffers[imageIndex]);
-
-    vk::SubmitInfo submitInfo{};
-    std::vector<vk::PipelineStageFlags> waitStages = {
-        vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    submitInfo.setWaitSemaphores(*m_imageAvailable);
-    submitInfo.setWaitDstStageMask(waitStages);
-    submitInfo.setCommandBuffers(*a_commandBuffer.getBuffer());
-    submitInfo.setSignalSemaphores(*m_renderFinished[imageIndex]);
-    a_device.getGraphicsQueue().submit(submitInfo, *m_inFlight);
-
-    vk::PresentInfoKHR presentInfo{};
-    presentInfo.setWaitSemaphores(*m_renderFinished[imageIndex]);
-    presentInfo.setSwapchains(*a_swapchain.getSwapchain());
-    presentInfo.setImageIndices(imageIndex);
-
-    [[maybe_unused]] vk::Result result2 =
-        a_device.getPresentQueue().presentKHR(presentInfo);
+    a_commandBuffer.record(a_swapchain, a_pipeline, a_framebuffers[imageIndex],
+                           options);
+
+    Submission submission;
+    submission.addWait(*m_imageAvailable,
+                       vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+    submission.addCommandBuffer(*a_commandBuffer.getBuffer());
+    submission.addSignal(*m_renderFinished[imageIndex],
+                         vk::PipelineStageFlagBits2::eAllCommands);
+    submission.fence = *m_inFlight;
+    submission.addPresent(a_swapchain, imageIndex,
+                          *m_renderFinished[imageIndex]);
+    for (const auto& target : m_targets) {
+        vk::Semaphore renderFinished =
+            *target.renderFinished[target.imageIndex];
+        submission.addWait(*target.imageAvailable,
+                           vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+        submission.addSignal(renderFinished,
+                             vk::PipelineStageFlagBits2::eAllCommands);
+        submission.addPresent(*target.swapchain, target.imageIndex,
+                              renderFinished);
+    }
+    m_lastSubmission = m_submitter.submit(submission);
+    // Presenting happens on the submission thread, so this is the duration
+    // of its latest present rather than this frame's.
+    m_timings.present = m_submitter.getPresentTime();
+}
+
+uint64_t Renderloop::getCurrentFrame() const noexcept {
+    return m_currentFrame;
+}
+
+uint64_t Renderloop::getCompletedFrame() const noexcept {
+    return m_completedFrame;
+}
+
+DeletionQueue& Renderloop::getDeletionQueue() noexcept {
+    return m_deletionQueue;
+}
+
+const FrameTimings& Renderloop::getTimings() const noexcept {
+    return m_timings;
+}
+
+void Renderloop::waitIdle() {
+    m_submitter.waitIdle();
+}
+
+Renderloop::TargetId Renderloop::addTarget(
+    const Device& a_device, const Swapchain& a_swapchain,
+    const std::vector<Framebuffer>& a_framebuffers) {
+    if (m_targets.size() == kMaxTargets) {
+        LOG4CPLUS_ERROR(m_logger, "Too many render targets");
+        throw std::runtime_error("Too many render targets");
+    }
+    vk::SemaphoreCreateInfo semaphoreCreateInfo{};
+    Target target{m_nextTargetId++, &a_swapchain, &a_framebuffers,
+                  a_device.getDevice().createSemaphore(semaphoreCreateInfo),
+                  {}};
+    for (size_t i = 0; i < a_framebuffers.size(); i++) {
+        target.renderFinished.push_back(
+            a_device.getDevice().createSemaphore(semaphoreCreateInfo));
+    }
+    LOG4CPLUS_INFO(m_logger, std::format("Adding render target {}", target.id));
+    m_targets.push_back(std::move(target));
+    return m_targets.back().id;
+}
+
+uint64_t Renderloop::removeTarget(TargetId a_target) {
+    auto it = std::find_if(m_targets.begin(), m_targets.end(),
+                           [&](const Target& target) {
+                               return target.id == a_target;
+                           });
+    if (it == m_targets.end()) {
+        LOG4CPLUS_ERROR(m_logger, "Unknown render target");
+        throw std::runtime_error("Unknown render target");
+    }
+    LOG4CPLUS_INFO(m_logger, std::format("Removing render target {}", a_target));
+    // Queued presents still point at the swapchain; once they went out only
+    // the GPU work of the current frame may use it.
+    m_submitter.waitIdle();
+    m_deletionQueue.retire(std::move(it->imageAvailable), m_currentFrame);
+    m_deletionQueue.retire(std::move(it->renderFinished), m_currentFrame);
+    m_targets.erase(it);
+    return m_currentFrame;
 }
 } // namespace compound
\ No newline at end of file
@@ -5,16 +5,70 @@
 #include "swapchain.hpp"
 #include "commandstructs.hpp"
 #include "framebuffer.hpp"
+#include "deletionqueue.hpp"
+#include "gputimer.hpp"
+#include "submitter.hpp"
+#include <log4cplus/log4cplus.h>
+#include <chrono>
+#include <optional>
 #include <vector>
 
 namespace compound {
+// Durations of the last frame in milliseconds. The GPU time lags one frame
+// behind since it is read back without waiting.
+struct FrameTimings {
+    double cpuFrame = 0.0;
+    double fenceWait = 0.0;
+    double acquire = 0.0;
+    double present = 0.0;
+    std::optional<double> gpu;
+};
+
+// Draws the primary window, passed to drawFrame, and up to kMaxTargets
+// further windows added as targets. All of them are acquired, recorded into one
+// command buffer, submitted together and presented with one call.
 class Renderloop {
 public:
+    using TargetId = uint32_t;
+    // Targets besides the primary swapchain that fit into one submission.
+    static constexpr size_t kMaxTargets = Submission::kMaxPresents - 1;
+
     Renderloop(const Device&, const std::vector<Framebuffer>&);
-    void drawFrame(const Device&, const std::vector<Framebuffer>&, const CommandBuffer&, const Swapchain&, const Pipeline&);
+    void drawFrame(const Device&, const std::vector<Framebuffer>&, const CommandBuffer&, const Swapchain&, const Pipeline&, const RecordOptions& = {});
+    uint64_t getCurrentFrame() const noexcept;
+    uint64_t getCompletedFrame() const noexcept;
+    DeletionQueue& getDeletionQueue() noexcept;
+    const FrameTimings& getTimings() const noexcept;
+    // Waits for the submission thread to hand everything to the queues.
+    void waitIdle();
+    // The swapchain and framebuffers must stay alive until the target was
+    // removed and the frame returned by removeTarget completed.
+    TargetId addTarget(const Device&, const Swapchain&, const std::vector<Framebuffer>&);
+    uint64_t removeTarget(TargetId);
 private:
+    struct Target {
+        TargetId id;
+        const Swapchain* swapchain;
+        const std::vector<Framebuffer>* framebuffers;
+        vk::raii::Semaphore imageAvailable;
+        std::vector<vk::raii::Semaphore> renderFinished;
+        uint32_t imageIndex = 0;
+    };
+    log4cplus::Logger m_logger = log4cplus::Logger::getInstance("compound.renderloop");
     vk::raii::Semaphore m_imageAvailable;
     std::vector<vk::raii::Semaphore> m_renderFinished;
     vk::raii::Fence m_inFlight;
+    uint64_t m_currentFrame = 0;
+    uint64_t m_completedFrame = 0;
+    DeletionQueue m_deletionQueue;
+    GpuTimer m_gpuTimer;
+    FrameTimings m_timings;
+    std::chrono::steady_clock::time_point m_lastFrameStart;
+    uint64_t m_lastSubmission = 0;
+    std::vector<Target> m_targets;
+    std::vector<TargetRecord> m_targetRecords;
+    TargetId m_nextTargetId = 0;
+    Submitter m_submitter;
+    uint32_t acquire(const Swapchain&, const vk::raii::Semaphore&);
 };
 }
\ No newline at end of file
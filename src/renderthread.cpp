@@ -0,0 +1,62 @@
+#include "renderthread.hpp"
+
+#include <utility>
+
+namespace compound {
+RenderThread::RenderThread(EventFunction onEvent, FrameFunction onFrame)
+    : m_onEvent(std::move(onEvent)), m_onFrame(std::move(onFrame)) {
+}
+
+RenderThread::~RenderThread() {
+    stop();
+}
+
+void RenderThread::start() {
+    LOG4CPLUS_INFO(m_logger, "Starting render thread");
+    m_running = true;
+    m_thread = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void RenderThread::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    LOG4CPLUS_INFO(m_logger, "Stopping render thread");
+    m_thread.request_stop();
+    m_thread.join();
+}
+
+void RenderThread::run(std::stop_token stopToken) {
+    try {
+        while (!stopToken.stop_requested()) {
+            while (auto event = m_events.pop()) {
+                m_onEvent(event.value());
+            }
+            m_frameInput.update();
+            m_onFrame(m_frameInput.getReadBuffer());
+        }
+    } catch (...) {
+        LOG4CPLUS_ERROR(m_logger, "Render thread failed");
+        m_exception = std::current_exception();
+    }
+    m_running.store(false, std::memory_order_release);
+}
+
+bool RenderThread::isRunning() const noexcept {
+    return m_running.load(std::memory_order_acquire);
+}
+
+void RenderThread::rethrowIfFailed() {
+    if (!isRunning() && m_exception) {
+        std::rethrow_exception(std::exchange(m_exception, nullptr));
+    }
+}
+
+EventQueue& RenderThread::getEventQueue() noexcept {
+    return m_events;
+}
+
+TripleBuffer<FrameInput>& RenderThread::getFrameInput() noexcept {
+    return m_frameInput;
+}
+} // namespace compound
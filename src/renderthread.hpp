@@ -0,0 +1,54 @@
+#pragma once
+
+#include "inputevent.hpp"
+#include "triplebuffer.hpp"
+#include <log4cplus/log4cplus.h>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+
+namespace compound {
+// State the main thread samples once per event loop iteration and hands to
+// the render thread; the render thread always sees the latest one.
+struct FrameInput {
+    uint64_t sequence = 0;
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+};
+
+// Runs frames on a dedicated thread so that event polling on the main thread
+// and rendering never delay each other. Events flow through a lock-free
+// queue, per-frame input through a triple buffer. An exception thrown on the
+// render thread stops it and is rethrown by rethrowIfFailed().
+class RenderThread {
+public:
+    using EventFunction = std::function<void(const InputEvent&)>;
+    using FrameFunction = std::function<void(const FrameInput&)>;
+    RenderThread(EventFunction onEvent, FrameFunction onFrame);
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+    ~RenderThread();
+    void start();
+    void stop();
+    bool isRunning() const noexcept;
+    void rethrowIfFailed();
+    EventQueue& getEventQueue() noexcept;
+    TripleBuffer<FrameInput>& getFrameInput() noexcept;
+
+private:
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.renderthread");
+    EventFunction m_onEvent;
+    FrameFunction m_onFrame;
+    EventQueue m_events;
+    TripleBuffer<FrameInput> m_frameInput;
+    std::atomic<bool> m_running = false;
+    std::exception_ptr m_exception;
+    std::jthread m_thread;
+    void run(std::stop_token stopToken);
+};
+} // namespace compound
@@ -0,0 +1,86 @@
+#include "shaderwatcher.hpp"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <array>
+#include <chrono>
+#include <format>
+
+namespace compound {
+ShaderWatcher::ShaderWatcher(Callback callback)
+    : m_callback(std::move(callback)) {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        LOG4CPLUS_ERROR(m_logger, "Failed to initialize inotify");
+        throw std::runtime_error("Failed to initialize inotify");
+    }
+    m_thread = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    m_thread.request_stop();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    close(m_fd);
+}
+
+void ShaderWatcher::watch(const std::filesystem::path& path) {
+    auto file = std::filesystem::absolute(path).lexically_normal();
+    auto directory = file.parent_path();
+    std::lock_guard lock(m_mutex);
+    m_files.insert(file);
+    for (const auto& [wd, watched] : m_directories) {
+        if (watched == directory) {
+            return;
+        }
+    }
+    int wd = inotify_add_watch(m_fd, directory.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0) {
+        LOG4CPLUS_ERROR(m_logger, std::format("Failed to watch {}",
+                                              directory.string()));
+        throw std::runtime_error("Failed to watch " + directory.string());
+    }
+    LOG4CPLUS_DEBUG(m_logger,
+                    std::format("Watching directory {}", directory.string()));
+    m_directories[wd] = directory;
+}
+
+void ShaderWatcher::run(std::stop_token stopToken) {
+    alignas(inotify_event) std::array<char, 4096> buffer;
+    while (!stopToken.stop_requested()) {
+        pollfd pfd{m_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        // Tools usually touch a file several times per save; give them a
+        // moment and report every file once.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::set<std::filesystem::path> changed;
+        ssize_t length;
+        while ((length = read(m_fd, buffer.data(), buffer.size())) > 0) {
+            std::lock_guard lock(m_mutex);
+            for (ssize_t offset = 0; offset < length;) {
+                auto* event =
+                    reinterpret_cast<const inotify_event*>(&buffer[offset]);
+                offset += sizeof(inotify_event) + event->len;
+                auto directory = m_directories.find(event->wd);
+                if (event->len == 0 || directory == m_directories.end()) {
+                    continue;
+                }
+                auto file = directory->second / event->name;
+                if (m_files.contains(file)) {
+                    changed.insert(file);
+                }
+            }
+        }
+        for (const auto& file : changed) {
+            LOG4CPLUS_INFO(m_logger,
+                           std::format("{} changed", file.string()));
+            m_callback(file);
+        }
+    }
+}
+} // namespace compound
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <log4cplus/log4cplus.h>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace compound {
+// Watches individual files through inotify on their parent directories, so
+// editors that save by renaming over the original are picked up too. The
+// callback runs on the watcher's own thread.
+class ShaderWatcher {
+public:
+    using Callback = std::function<void(const std::filesystem::path&)>;
+    explicit ShaderWatcher(Callback callback);
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+    ~ShaderWatcher();
+    void watch(const std::filesystem::path& path);
+
+private:
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.shaderwatcher");
+    Callback m_callback;
+    int m_fd = -1;
+    std::mutex m_mutex;
+    std::map<int, std::filesystem::path> m_directories;
+    std::set<std::filesystem::path> m_files;
+    std::jthread m_thread;
+    void run(std::stop_token stopToken);
+};
+} // namespace compound
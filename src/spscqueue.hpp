@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+namespace compound {
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Each side caches the other side's index so that the shared cache line is
+// only touched when the queue looks full or empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+public:
+    bool push(const T& value) noexcept {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail == Capacity) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail == Capacity) {
+                return false;
+            }
+        }
+        m_items[head & (Capacity - 1)] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> pop() noexcept {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_cachedHead) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail == m_cachedHead) {
+                return std::nullopt;
+            }
+        }
+        T value = m_items[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return value;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> m_head = 0;
+    size_t m_cachedTail = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+    size_t m_cachedHead = 0;
+    alignas(64) std::array<T, Capacity> m_items{};
+};
+} // namespace compound
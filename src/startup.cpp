@@ -0,0 +1,69 @@
+#include "startup.hpp"
+
+#include "jobsystem.hpp"
+#include <log4cplus/loggingmacros.h>
+#include <algorithm>
+#include <exception>
+#include <format>
+#include <memory>
+
+namespace compound {
+Startup::Startup() : m_start(Clock::now()) {
+}
+
+void Startup::run(const std::string& name, const Step& step) {
+    auto begin = Clock::now();
+    step();
+    record(name, begin, false);
+}
+
+std::future<void> Startup::launch(const std::string& name, Step step) {
+    // std::function needs a copyable target, so the promise is shared.
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    JobSystem::get().run([this, name, step = std::move(step), promise] {
+        auto begin = Clock::now();
+        try {
+            step();
+            record(name, begin, true);
+            promise->set_value();
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+void Startup::record(const std::string& name, Clock::time_point begin,
+                     bool background) {
+    auto end = Clock::now();
+    std::chrono::duration<double, std::milli> offset = begin - m_start;
+    std::chrono::duration<double, std::milli> duration = end - begin;
+    std::lock_guard lock(m_mutex);
+    m_phases.push_back({name, offset.count(), duration.count(), background});
+}
+
+void Startup::report() const {
+    std::chrono::duration<double, std::milli> total = Clock::now() - m_start;
+    std::vector<Phase> phases;
+    {
+        std::lock_guard lock(m_mutex);
+        phases = m_phases;
+    }
+    std::sort(phases.begin(), phases.end(),
+              [](const Phase& a, const Phase& b) { return a.begin < b.begin; });
+    double work = 0.0;
+    LOG4CPLUS_INFO(m_logger, "Startup breakdown :");
+    for (const auto& phase : phases) {
+        work += phase.duration;
+        LOG4CPLUS_INFO(m_logger,
+                       std::format("  {:<28} at {:8.2f} ms took {:8.2f} ms{}",
+                                   phase.name, phase.begin, phase.duration,
+                                   phase.background ? " (background)" : ""));
+    }
+    LOG4CPLUS_INFO(
+        m_logger,
+        std::format("Startup took {:.2f} ms for {:.2f} ms of work", total.count(),
+                    work));
+}
+} // namespace compound
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <log4cplus/logger.h>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace compound {
+// Times the steps of application startup. Steps that must stay on the
+// calling thread (window creation) go through run(), independent ones go
+// through launch() onto the job system so they overlap with the rest.
+class Startup {
+public:
+    using Step = std::function<void()>;
+
+    Startup();
+    void run(const std::string& name, const Step& step);
+    std::future<void> launch(const std::string& name, Step step);
+    // Logs every step with its start offset and duration, followed by the
+    // wall-clock total against the summed step time.
+    void report() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Phase {
+        std::string name;
+        double begin;
+        double duration;
+        bool background;
+    };
+
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.startup");
+    Clock::time_point m_start;
+    mutable std::mutex m_mutex;
+    std::vector<Phase> m_phases;
+
+    void record(const std::string& name, Clock::time_point begin,
+                bool background);
+};
+} // namespace compound
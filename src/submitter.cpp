@@ -0,0 +1,223 @@
+#include "submitter.hpp"
+
+#include <log4cplus/loggingmacros.h>
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <limits>
+
+namespace compound {
+void Submission::addCommandBuffer(vk::CommandBuffer buffer) {
+    if (commandBufferCount == kMaxCommandBuffers) {
+        throw std::runtime_error("Too many command buffers in a submission");
+    }
+    commandBuffers[commandBufferCount++] = vk::CommandBufferSubmitInfo(buffer);
+}
+
+void Submission::addWait(vk::Semaphore semaphore,
+                         vk::PipelineStageFlags2 stages) {
+    if (waitCount == kMaxSemaphores) {
+        throw std::runtime_error("Too many wait semaphores in a submission");
+    }
+    waits[waitCount++] = vk::SemaphoreSubmitInfo(semaphore, 0, stages);
+}
+
+void Submission::addSignal(vk::Semaphore semaphore,
+                           vk::PipelineStageFlags2 stages) {
+    if (signalCount == kMaxSemaphores) {
+        throw std::runtime_error("Too many signal semaphores in a submission");
+    }
+    signals[signalCount++] = vk::SemaphoreSubmitInfo(semaphore, 0, stages);
+}
+
+void Submission::addPresent(const Swapchain& swapchain, uint32_t imageIndex,
+                            vk::Semaphore wait) {
+    if (presentCount == kMaxPresents) {
+        throw std::runtime_error("Too many presents in a submission");
+    }
+    presents[presentCount++] = {&swapchain, imageIndex, wait};
+}
+
+Submitter::Submitter(const Device& device)
+    : m_queue(device.getGraphicsQueue()),
+      m_presentQueue(device.getPresentQueue()) {
+    LOG4CPLUS_INFO(m_logger, "Starting submission thread");
+    m_thread = std::jthread([this](std::stop_token stopToken) {
+        run(stopToken);
+    });
+}
+
+Submitter::~Submitter() {
+    m_thread.request_stop();
+    m_wake.fetch_add(1, std::memory_order_release);
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+uint64_t Submitter::submit(const Submission& submission) {
+    rethrowIfFailed();
+    // The thread stops popping once it failed, so a full queue would never
+    // drain.
+    while (!m_submissions.push(submission)) {
+        rethrowIfFailed();
+        std::this_thread::yield();
+    }
+    m_wake.fetch_add(1, std::memory_order_release);
+    m_wake.notify_one();
+    return ++m_sequence;
+}
+
+void Submitter::waitSubmitted(uint64_t sequence) {
+    uint64_t submitted = m_submitted.load(std::memory_order_acquire);
+    while (submitted < sequence) {
+        m_submitted.wait(submitted, std::memory_order_acquire);
+        submitted = m_submitted.load(std::memory_order_acquire);
+    }
+    rethrowIfFailed();
+}
+
+void Submitter::waitPresented(uint64_t sequence) {
+    uint64_t processed = m_processed.load(std::memory_order_acquire);
+    while (processed < sequence) {
+        m_processed.wait(processed, std::memory_order_acquire);
+        processed = m_processed.load(std::memory_order_acquire);
+    }
+    rethrowIfFailed();
+}
+
+void Submitter::waitIdle() {
+    waitPresented(m_sequence);
+}
+
+void Submitter::rethrowIfFailed() const {
+    if (m_failed.load(std::memory_order_acquire)) {
+        std::rethrow_exception(m_error);
+    }
+}
+
+vk::Result Submitter::getPresentResult() const noexcept {
+    return m_presentResult.load(std::memory_order_relaxed);
+}
+
+double Submitter::getPresentTime() const noexcept {
+    return m_presentTime.load(std::memory_order_relaxed);
+}
+
+void Submitter::run(std::stop_token stopToken) {
+    std::vector<Submission> batch;
+    batch.reserve(kQueueCapacity);
+    while (true) {
+        uint32_t wake = m_wake.load(std::memory_order_acquire);
+        while (auto submission = m_submissions.pop()) {
+            batch.push_back(*submission);
+        }
+        if (!batch.empty()) {
+            try {
+                flush(batch);
+            } catch (const std::exception& e) {
+                LOG4CPLUS_ERROR(m_logger,
+                                std::format("Submission failed: {}", e.what()));
+                m_error = std::current_exception();
+                m_failed.store(true, std::memory_order_release);
+                m_submitted.store(std::numeric_limits<uint64_t>::max(),
+                                  std::memory_order_release);
+                m_submitted.notify_all();
+                m_processed.store(std::numeric_limits<uint64_t>::max(),
+                                  std::memory_order_release);
+                m_processed.notify_all();
+                return;
+            }
+            batch.clear();
+            continue;
+        }
+        if (stopToken.stop_requested()) {
+            return;
+        }
+        m_wake.wait(wake, std::memory_order_acquire);
+    }
+}
+
+void Submitter::flush(std::vector<Submission>& batch) {
+    // A fence covers a whole vkQueueSubmit2 call, so a fenced submission
+    // closes its group.
+    size_t begin = 0;
+    while (begin < batch.size()) {
+        size_t end = begin;
+        while (end < batch.size() && !batch[end++].fence) {
+        }
+        std::vector<vk::SubmitInfo2> submitInfos;
+        for (size_t i = begin; i < end; i++) {
+            const auto& submission = batch[i];
+            auto& submitInfo = submitInfos.emplace_back();
+            submitInfo.waitSemaphoreInfoCount = submission.waitCount;
+            submitInfo.pWaitSemaphoreInfos = submission.waits.data();
+            submitInfo.commandBufferInfoCount = submission.commandBufferCount;
+            submitInfo.pCommandBufferInfos = submission.commandBuffers.data();
+            submitInfo.signalSemaphoreInfoCount = submission.signalCount;
+            submitInfo.pSignalSemaphoreInfos = submission.signals.data();
+        }
+        m_queue.submit2(submitInfos, batch[end - 1].fence);
+        m_submitted.fetch_add(end - begin, std::memory_order_release);
+        m_submitted.notify_all();
+
+        // A swapchain may only appear once per present call, so a second
+        // image of the same swapchain starts a new one.
+        std::vector<Submission::Present> presents;
+        for (size_t i = begin; i < end; i++) {
+            const auto& submission = batch[i];
+            for (uint32_t j = 0; j < submission.presentCount; j++) {
+                const auto& present = submission.presents[j];
+                if (std::any_of(presents.begin(), presents.end(),
+                                [&](const Submission::Present& queued) {
+                                    return queued.swapchain ==
+                                           present.swapchain;
+                                })) {
+                    flushPresents(presents);
+                }
+                presents.push_back(present);
+            }
+        }
+        flushPresents(presents);
+        m_processed.fetch_add(end - begin, std::memory_order_release);
+        m_processed.notify_all();
+        begin = end;
+    }
+}
+
+void Submitter::flushPresents(std::vector<Submission::Present>& presents) {
+    if (presents.empty()) {
+        return;
+    }
+    std::vector<vk::Semaphore> waits;
+    std::vector<vk::SwapchainKHR> swapchains;
+    std::vector<uint32_t> imageIndices;
+    for (const auto& present : presents) {
+        waits.push_back(present.wait);
+        swapchains.push_back(*present.swapchain->getSwapchain());
+        imageIndices.push_back(present.imageIndex);
+    }
+    presents.clear();
+    vk::PresentInfoKHR presentInfo{};
+    presentInfo.setWaitSemaphores(waits);
+    presentInfo.setSwapchains(swapchains);
+    presentInfo.setImageIndices(imageIndices);
+    auto presentStart = std::chrono::steady_clock::now();
+    vk::Result result;
+    try {
+        result = m_presentQueue.presentKHR(presentInfo);
+    } catch (vk::OutOfDateKHRError&) {
+        result = vk::Result::eErrorOutOfDateKHR;
+    }
+    m_presentTime.store(
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - presentStart)
+            .count(),
+        std::memory_order_relaxed);
+    if (result != vk::Result::eSuccess &&
+        result != m_presentResult.load(std::memory_order_relaxed)) {
+        LOG4CPLUS_WARN(m_logger,
+                       std::format("Present returned {}", vk::to_string(result)));
+    }
+    m_presentResult.store(result, std::memory_order_relaxed);
+}
+} // namespace compound
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "swapchain.hpp"
+#include "spscqueue.hpp"
+#include <log4cplus/log4cplus.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace compound {
+// Work of one frame: command buffers with the semaphores they wait on and
+// signal, an optional fence and the images to present once submitted. Sizes
+// are fixed so that handing a submission over never allocates.
+struct Submission {
+    static constexpr size_t kMaxCommandBuffers = 8;
+    static constexpr size_t kMaxSemaphores = 8;
+    static constexpr size_t kMaxPresents = 8;
+    struct Present {
+        const Swapchain* swapchain = nullptr;
+        uint32_t imageIndex = 0;
+        vk::Semaphore wait;
+    };
+
+    std::array<vk::CommandBufferSubmitInfo, kMaxCommandBuffers> commandBuffers;
+    uint32_t commandBufferCount = 0;
+    std::array<vk::SemaphoreSubmitInfo, kMaxSemaphores> waits;
+    uint32_t waitCount = 0;
+    std::array<vk::SemaphoreSubmitInfo, kMaxSemaphores> signals;
+    uint32_t signalCount = 0;
+    std::array<Present, kMaxPresents> presents;
+    uint32_t presentCount = 0;
+    vk::Fence fence;
+
+    void addCommandBuffer(vk::CommandBuffer buffer);
+    void addWait(vk::Semaphore semaphore, vk::PipelineStageFlags2 stages);
+    void addSignal(vk::Semaphore semaphore, vk::PipelineStageFlags2 stages);
+    void addPresent(const Swapchain& swapchain, uint32_t imageIndex,
+                    vk::Semaphore wait);
+};
+
+// Owns the graphics queue on a thread of its own. The render thread pushes
+// submissions through a lock-free queue and moves on; the thread turns
+// everything queued so far into as few vkQueueSubmit2 calls as fences allow
+// and presents all the images of those submissions with a single
+// vkQueuePresentKHR.
+//
+// Only one thread may submit. Acquiring from a swapchain must wait for the
+// presents of earlier submissions with waitPresented(), as the two are not
+// allowed to overlap.
+class Submitter {
+public:
+    explicit Submitter(const Device& device);
+    Submitter(const Submitter&) = delete;
+    Submitter& operator=(const Submitter&) = delete;
+    ~Submitter();
+    // Returns the sequence number of the submission.
+    uint64_t submit(const Submission& submission);
+    // Blocks until the submit call of the given submission returned, after
+    // which its fence may be waited on and reset.
+    void waitSubmitted(uint64_t sequence);
+    // Blocks until the images of the given submission were presented.
+    void waitPresented(uint64_t sequence);
+    // Blocks until everything submitted so far was also presented, so that
+    // the queues can be used from another thread again.
+    void waitIdle();
+    vk::Result getPresentResult() const noexcept;
+    // Duration of the last present call in milliseconds.
+    double getPresentTime() const noexcept;
+
+private:
+    static constexpr size_t kQueueCapacity = 16;
+
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.submitter");
+    const vk::raii::Queue& m_queue;
+    const vk::raii::Queue& m_presentQueue;
+    SpscQueue<Submission, kQueueCapacity> m_submissions;
+    uint64_t m_sequence = 0;
+    std::atomic<uint32_t> m_wake = 0;
+    std::atomic<uint64_t> m_submitted = 0;
+    std::atomic<uint64_t> m_processed = 0;
+    std::atomic<vk::Result> m_presentResult = vk::Result::eSuccess;
+    std::atomic<double> m_presentTime = 0.0;
+    // Written by the thread before it sets m_failed, read only after.
+    std::exception_ptr m_error;
+    std::atomic<bool> m_failed = false;
+    std::jthread m_thread;
+
+    void run(std::stop_token stopToken);
+    void flush(std::vector<Submission>& batch);
+    void flushPresents(std::vector<Submission::Present>& presents);
+    void rethrowIfFailed() const;
+};
+} // namespace compound
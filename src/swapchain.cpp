@@ -6,6 +6,15 @@ namespace compound {
 Swapchain::Swapchain(const Device& device, const Window& window)
     : m_swapchain(0) {
     LOG4CPLUS_INFO(m_logger, "Creating swapchain");
+    // The presentation family was picked for the first window's surface;
+    // further windows have to be presentable from the same queue.
+    if (!device.getPhysicalDevice().getSurfaceSupportKHR(
+            device.getPresentationFamilyQueueIndex(), *window.getSurface())) {
+        LOG4CPLUS_ERROR(m_logger,
+                        "Surface is not supported by the presentation queue");
+        throw std::runtime_error(
+            "Surface is not supported by the presentation queue");
+    }
     auto availableFormats =
         device.getPhysicalDevice().getSurfaceFormatsKHR(*window.getSurface());
 
@@ -56,6 +65,14 @@ Swapchain::Swapchain(const Device& device, const Window& window)
     swapchainCreateInfo.imageExtent = extent;
     swapchainCreateInfo.imageArrayLayers = 1;
     swapchainCreateInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    // Lets an offscreen render target be blitted in, see DynamicResolution,
+    // and presented images be read back, see FrameCapture.
+    for (auto usage : {vk::ImageUsageFlagBits::eTransferDst,
+                       vk::ImageUsageFlagBits::eTransferSrc}) {
+        if (surfaceCapabilities.supportedUsageFlags & usage) {
+            swapchainCreateInfo.imageUsage |= usage;
+        }
+    }
     std::array<uint32_t, 2> indices = {
         device.getGraphicsFamilyQueueIndex(),
         device.getPresentationFamilyQueueIndex()};
@@ -74,8 +91,11 @@ Swapchain::Swapchain(const Device& device, const Window& window)
     m_swapchain = device.getDevice().createSwapchainKHR(swapchainCreateInfo);
     m_swapchainExtent = extent;
     m_swapchainFormat = selectedFormat.value().format;
+    m_imageUsage = swapchainCreateInfo.imageUsage;
 
-    auto m_images = m_swapchain.getImages();
+    for (auto image : m_swapchain.getImages()) {
+        m_images.emplace_back(image);
+    }
     vk::ImageViewCreateInfo imageViewCreateInfo{};
     imageViewCreateInfo.viewType = vk::ImageViewType::e2D;
     imageViewCreateInfo.format = selectedFormat.value().format;
@@ -97,6 +117,14 @@ const vk::Format& Swapchain::getFormat() const noexcept {
     return m_swapchainFormat;
 }
 
+vk::ImageUsageFlags Swapchain::getImageUsage() const noexcept {
+    return m_imageUsage;
+}
+
+const std::vector<vk::Image>& Swapchain::getImages() const noexcept {
+    return m_images;
+}
+
 const std::vector<vk::raii::ImageView>& Swapchain::getImageViews()
     const noexcept {
     return m_imageViews;
@@ -12,11 +12,16 @@ private:
     log4cplus::Logger m_logger = log4cplus::Logger::getInstance("compound.swapchain");
     vk::Format m_swapchainFormat;
     vk::Extent2D m_swapchainExtent;
+    vk::ImageUsageFlags m_imageUsage;
     vk::raii::SwapchainKHR m_swapchain;
+    std::vector<vk::Image> m_images;
     std::vector<vk::raii::ImageView> m_imageViews;
 public:
     const vk::Extent2D& getExtent() const noexcept;
     const vk::Format& getFormat() const noexcept;
+    // Transfer usages are only present when the surface supports them.
+    vk::ImageUsageFlags getImageUsage() const noexcept;
+    const std::vector<vk::Image>& getImages() const noexcept;
     const std::vector<vk::raii::ImageView>& getImageViews() const noexcept;
     const vk::raii::SwapchainKHR& getSwapchain() const noexcept;
 };
@@ -0,0 +1,547 @@
+#include "texturestreamer.hpp"
+
+#include <log4cplus/loggingmacros.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <iterator>
+
+namespace compound {
+namespace {
+struct TexelBlock {
+    uint32_t size;
+    uint32_t bytes;
+};
+
+TexelBlock getTexelBlock(vk::Format format) noexcept {
+    using enum vk::Format;
+    switch (format) {
+    case eR8Unorm:
+    case eR8Srgb:
+        return {1, 1};
+    case eR8G8Unorm:
+    case eR8G8Srgb:
+        return {1, 2};
+    case eR8G8B8A8Unorm:
+    case eR8G8B8A8Srgb:
+    case eB8G8R8A8Unorm:
+    case eB8G8R8A8Srgb:
+    case eA2B10G10R10UnormPack32:
+        return {1, 4};
+    case eR16G16B16A16Sfloat:
+        return {1, 8};
+    case eR32G32B32A32Sfloat:
+        return {1, 16};
+    case eBc1RgbUnormBlock:
+    case eBc1RgbSrgbBlock:
+    case eBc1RgbaUnormBlock:
+    case eBc1RgbaSrgbBlock:
+    case eBc4UnormBlock:
+    case eBc4SnormBlock:
+        return {4, 8};
+    case eBc2UnormBlock:
+    case eBc2SrgbBlock:
+    case eBc3UnormBlock:
+    case eBc3SrgbBlock:
+    case eBc5UnormBlock:
+    case eBc5SnormBlock:
+    case eBc6HUfloatBlock:
+    case eBc6HSfloatBlock:
+    case eBc7UnormBlock:
+    case eBc7SrgbBlock:
+        return {4, 16};
+    default:
+        return {0, 0};
+    }
+}
+
+vk::Extent2D getLevelExtent(vk::Extent2D extent, uint32_t level) noexcept {
+    return {std::max(extent.width >> level, 1u),
+            std::max(extent.height >> level, 1u)};
+}
+} // namespace
+
+TextureStreamer::TextureStreamer(const Device& device, Allocator& allocator,
+                                 vk::DeviceSize budget)
+    : m_device(device), m_allocator(allocator), m_sampler(0),
+      m_budget(budget) {
+    LOG4CPLUS_INFO(m_logger,
+                   std::format("Creating texture streamer with a {} MiB budget",
+                               budget / (1024 * 1024)));
+    // Views only cover resident levels, so the sampler itself never needs
+    // to clamp the level of detail.
+    vk::SamplerCreateInfo samplerCreateInfo{};
+    samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eRepeat);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eRepeat);
+    samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eRepeat);
+    samplerCreateInfo.setMinLod(0.0f);
+    samplerCreateInfo.setMaxLod(vk::LodClampNone);
+    m_sampler = device.getDevice().createSampler(samplerCreateInfo);
+}
+
+TextureStreamer::~TextureStreamer() {
+    m_stopping = true;
+    JobSystem::get().wait(m_loading);
+    m_deletionQueue.flush();
+}
+
+TextureStreamer::TextureId TextureStreamer::add(TextureSource source) {
+    if (!source.loadLevel || source.mipLevels == 0 ||
+        source.extent.width == 0 || source.extent.height == 0 ||
+        getTexelBlock(source.format).size == 0) {
+        LOG4CPLUS_ERROR(m_logger, "Invalid or unsupported texture source");
+        throw std::runtime_error("Invalid or unsupported texture source");
+    }
+    uint32_t maxLevels =
+        std::bit_width(std::max(source.extent.width, source.extent.height));
+    source.mipLevels = std::min(source.mipLevels, maxLevels);
+
+    auto texture = std::make_unique<Texture>();
+    texture->source = std::make_shared<const TextureSource>(std::move(source));
+    const auto& added = *texture->source;
+    texture->tailLevel = added.mipLevels - 1;
+    for (uint32_t level = 0; level < added.mipLevels; level++) {
+        auto extent = getLevelExtent(added.extent, level);
+        if (std::max(extent.width, extent.height) <= kInitialSize) {
+            texture->tailLevel = level;
+            break;
+        }
+    }
+    texture->residentLevel = added.mipLevels;
+    texture->requestedLevel = texture->tailLevel;
+
+    TextureId id;
+    if (m_freeIds.empty()) {
+        id = static_cast<TextureId>(m_textures.size());
+        m_textures.push_back(std::move(texture));
+    } else {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+        m_textures[id] = std::move(texture);
+    }
+    schedule(id, m_textures[id]->tailLevel);
+    return id;
+}
+
+void TextureStreamer::remove(TextureId id, uint64_t lastUsed) {
+    auto& texture = getTexture(id);
+    m_residentBytes -= getResidentSize(texture, texture.residentLevel);
+    if (texture.view) {
+        m_deletionQueue.retire(std::move(*texture.view), lastUsed);
+    }
+    m_deletionQueue.retire(std::move(texture.image), lastUsed);
+    // A load still in flight is recognised as stale by its source.
+    m_textures[id].reset();
+    m_freeIds.push_back(id);
+}
+
+void TextureStreamer::request(TextureId id, uint32_t level, uint64_t frame) {
+    auto& texture = getTexture(id);
+    level = std::min(level, texture.tailLevel);
+    texture.requestedLevel = texture.lastRequested == frame
+                                 ? std::min(texture.requestedLevel, level)
+                                 : level;
+    texture.lastRequested = frame;
+}
+
+uint32_t TextureStreamer::levelForCoverage(vk::Extent2D extent, float pixels) {
+    float size = static_cast<float>(std::max(extent.width, extent.height));
+    if (pixels >= size) {
+        return 0;
+    }
+    if (pixels <= 1.0f) {
+        return std::bit_width(static_cast<uint32_t>(size)) - 1;
+    }
+    return static_cast<uint32_t>(std::floor(std::log2(size / pixels)));
+}
+
+void TextureStreamer::setBudget(vk::DeviceSize budget) noexcept {
+    m_budget = budget;
+}
+
+void TextureStreamer::setUploadBudget(vk::DeviceSize bytesPerFrame) noexcept {
+    m_uploadBudget = bytesPerFrame;
+}
+
+void TextureStreamer::schedule(TextureId id, uint32_t level) {
+    auto& texture = getTexture(id);
+    texture.loading = true;
+    uint32_t end = std::min(texture.residentLevel, texture.source->mipLevels);
+    JobSystem::get().run(
+        [this, id, level, end, source = texture.source] {
+            if (m_stopping) {
+                return;
+            }
+            Load load{id, level, source, {}};
+            try {
+                for (uint32_t i = level; i < end; i++) {
+                    auto data = source->loadLevel(i);
+                    auto expected = getLevelSize(source->format,
+                                                 source->extent, i);
+                    if (data.size() != expected) {
+                        throw std::runtime_error(std::format(
+                            "level {} holds {} bytes instead of {}", i,
+                            data.size(), expected));
+                    }
+                    load.levels.push_back(std::move(data));
+                }
+            } catch (std::exception& e) {
+                LOG4CPLUS_ERROR(m_logger,
+                                std::format("Texture {} failed to load : {}",
+                                            id, e.what()));
+                load.levels.clear();
+            }
+            std::lock_guard lock(m_mutex);
+            m_finished.push_back(std::move(load));
+        },
+        &m_loading);
+}
+
+void TextureStreamer::record(const vk::raii::CommandBuffer& buffer,
+                             uint64_t frame) {
+    std::vector<Load> finished;
+    {
+        std::lock_guard lock(m_mutex);
+        finished.swap(m_finished);
+    }
+    vk::DeviceSize uploaded = 0;
+    std::vector<Load> deferred;
+    for (auto& load : finished) {
+        Texture* texture =
+            load.id < m_textures.size() ? m_textures[load.id].get() : nullptr;
+        if (!texture || texture->source != load.source) {
+            continue;
+        }
+        if (load.levels.empty()) {
+            texture->loading = false;
+            texture->failed = true;
+            continue;
+        }
+        // Residency was lowered while the levels were loading, leaving a gap
+        // between them and what is on the GPU.
+        if (load.level + load.levels.size() != texture->residentLevel) {
+            texture->loading = false;
+            continue;
+        }
+        vk::DeviceSize bytes = 0;
+        for (const auto& level : load.levels) {
+            bytes += level.size();
+        }
+        if (uploaded > 0 && uploaded + bytes > m_uploadBudget) {
+            deferred.push_back(std::move(load));
+            continue;
+        }
+        uploaded += bytes;
+        reallocate(buffer, *texture, load.level, &load, frame);
+        texture->loading = false;
+    }
+    if (!deferred.empty()) {
+        std::lock_guard lock(m_mutex);
+        std::move(deferred.begin(), deferred.end(),
+                  std::back_inserter(m_finished));
+    }
+
+    auto desiredLevel = [&](const Texture& texture) {
+        return frame - texture.lastRequested > kIdleFrames
+                   ? texture.tailLevel
+                   : texture.requestedLevel;
+    };
+    std::vector<TextureId> resident;
+    for (TextureId id = 0; id < m_textures.size(); id++) {
+        auto* texture = m_textures[id].get();
+        if (!texture || texture->loading ||
+            texture->residentLevel == texture->source->mipLevels) {
+            continue;
+        }
+        resident.push_back(id);
+        uint32_t desired = desiredLevel(*texture);
+        if (texture->residentLevel < desired) {
+            reallocate(buffer, *texture, desired, nullptr, frame);
+            m_evictions++;
+        }
+    }
+
+    // Least recently used textures give up their finest level first until
+    // the budget holds again.
+    std::sort(resident.begin(), resident.end(), [&](TextureId a, TextureId b) {
+        return m_textures[a]->lastRequested < m_textures[b]->lastRequested;
+    });
+    for (auto it = resident.begin();
+         m_residentBytes > m_budget && it != resident.end();) {
+        auto& texture = *m_textures[*it];
+        if (texture.residentLevel >= texture.tailLevel) {
+            it++;
+            continue;
+        }
+        reallocate(buffer, texture, texture.residentLevel + 1, nullptr, frame);
+        m_evictions++;
+    }
+
+    // Raise the most recently requested textures one level at a time, as far
+    // as the budget allows with the loads already in flight counted in.
+    vk::DeviceSize projected = m_residentBytes;
+    for (const auto& texture : m_textures) {
+        if (texture && texture->loading &&
+            texture->residentLevel < texture->source->mipLevels) {
+            projected += getLevelSize(texture->source->format,
+                                      texture->source->extent,
+                                      texture->residentLevel - 1);
+        }
+    }
+    for (auto it = resident.rbegin(); it != resident.rend(); it++) {
+        auto& texture = *m_textures[*it];
+        if (texture.failed || texture.residentLevel == 0 ||
+            desiredLevel(texture) >= texture.residentLevel) {
+            continue;
+        }
+        auto cost = getLevelSize(texture.source->format,
+                                 texture.source->extent,
+                                 texture.residentLevel - 1);
+        if (projected + cost > m_budget) {
+            continue;
+        }
+        projected += cost;
+        schedule(*it, texture.residentLevel - 1);
+    }
+}
+
+void TextureStreamer::reallocate(const vk::raii::CommandBuffer& buffer,
+                                 Texture& texture, uint32_t residentLevel,
+                                 const Load* load, uint64_t frame) {
+    const auto& source = *texture.source;
+    uint32_t levelCount = source.mipLevels - residentLevel;
+    auto extent = getLevelExtent(source.extent, residentLevel);
+    vk::ImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.setImageType(vk::ImageType::e2D);
+    imageCreateInfo.setFormat(source.format);
+    imageCreateInfo.setExtent({extent.width, extent.height, 1});
+    imageCreateInfo.setMipLevels(levelCount);
+    imageCreateInfo.setArrayLayers(1);
+    imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+    imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+    imageCreateInfo.setUsage(vk::ImageUsageFlagBits::eSampled |
+                             vk::ImageUsageFlagBits::eTransferSrc |
+                             vk::ImageUsageFlagBits::eTransferDst);
+    imageCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
+    imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+    VmaAllocationCreateInfo allocationCreateInfo{};
+    allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+    Image image = m_allocator.createImage(imageCreateInfo, allocationCreateInfo,
+                                          MemoryCategory::eTexture);
+
+    bool hasOld = texture.residentLevel < source.mipLevels;
+    std::vector<vk::ImageMemoryBarrier> before(1);
+    before[0].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    before[0].setOldLayout(vk::ImageLayout::eUndefined);
+    before[0].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+    before[0].setImage(image.getImage());
+    before[0].setSubresourceRange(vk::ImageSubresourceRange(
+        vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1));
+    if (hasOld) {
+        auto& old = before.emplace_back();
+        old.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+        old.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+        old.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+        old.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+        old.setImage(texture.image.getImage());
+        old.setSubresourceRange(vk::ImageSubresourceRange(
+            vk::ImageAspectFlagBits::eColor, 0,
+            source.mipLevels - texture.residentLevel, 0, 1));
+    }
+    for (auto& barrier : before) {
+        barrier.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
+        barrier.setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+    }
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader |
+                               vk::PipelineStageFlagBits::eTopOfPipe,
+                           vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                           before);
+
+    if (hasOld) {
+        std::vector<vk::ImageCopy> regions;
+        for (uint32_t level = std::max(residentLevel, texture.residentLevel);
+             level < source.mipLevels; level++) {
+            auto levelExtent = getLevelExtent(source.extent, level);
+            vk::ImageCopy& region = regions.emplace_back();
+            region.setSrcSubresource({vk::ImageAspectFlagBits::eColor,
+                                      level - texture.residentLevel, 0, 1});
+            region.setDstSubresource(
+                {vk::ImageAspectFlagBits::eColor, level - residentLevel, 0, 1});
+            region.setExtent({levelExtent.width, levelExtent.height, 1});
+        }
+        buffer.copyImage(texture.image.getImage(),
+                         vk::ImageLayout::eTransferSrcOptimal, image.getImage(),
+                         vk::ImageLayout::eTransferDstOptimal, regions);
+    }
+
+    if (load) {
+        vk::DeviceSize size = 0;
+        for (const auto& level : load->levels) {
+            size += level.size();
+        }
+        vk::BufferCreateInfo bufferCreateInfo{};
+        bufferCreateInfo.setSize(size);
+        bufferCreateInfo.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
+        bufferCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
+        VmaAllocationCreateInfo stagingCreateInfo{};
+        stagingCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+        stagingCreateInfo.flags =
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        Buffer staging = m_allocator.createBuffer(
+            bufferCreateInfo, stagingCreateInfo, MemoryCategory::eStaging);
+        std::vector<vk::BufferImageCopy> regions;
+        vk::DeviceSize offset = 0;
+        for (uint32_t i = 0; i < load->levels.size(); i++) {
+            const auto& data = load->levels[i];
+            std::memcpy(static_cast<std::byte*>(staging.getMappedData()) +
+                            offset,
+                        data.data(), data.size());
+            auto levelExtent = getLevelExtent(source.extent, load->level + i);
+            vk::BufferImageCopy& region = regions.emplace_back();
+            region.setBufferOffset(offset);
+            region.setImageSubresource({vk::ImageAspectFlagBits::eColor,
+                                        load->level + i - residentLevel, 0,
+                                        1});
+            region.setImageExtent({levelExtent.width, levelExtent.height, 1});
+            offset += data.size();
+        }
+        vmaFlushAllocation(m_allocator.getAllocator(), staging.getAllocation(),
+                           0, VK_WHOLE_SIZE);
+        buffer.copyBufferToImage(staging.getBuffer(), image.getImage(),
+                                 vk::ImageLayout::eTransferDstOptimal, regions);
+        m_uploadedBytes += size;
+        m_deletionQueue.retire(std::move(staging), frame);
+    }
+
+    vk::ImageMemoryBarrier after{};
+    after.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    after.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    after.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    after.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    after.setSrcQueueFamilyIndex(vk::QueueFamilyIgnored);
+    after.setDstQueueFamilyIndex(vk::QueueFamilyIgnored);
+    after.setImage(image.getImage());
+    after.setSubresourceRange(vk::ImageSubresourceRange(
+        vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1));
+    buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                           vk::PipelineStageFlagBits::eFragmentShader, {}, {},
+                           {}, after);
+
+    vk::ImageViewCreateInfo imageViewCreateInfo{};
+    imageViewCreateInfo.setImage(image.getImage());
+    imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+    imageViewCreateInfo.setFormat(source.format);
+    imageViewCreateInfo.setSubresourceRange(vk::ImageSubresourceRange(
+        vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1));
+    auto view = m_device.getDevice().createImageView(imageViewCreateInfo);
+
+    if (texture.view) {
+        m_deletionQueue.retire(std::move(*texture.view), frame);
+    }
+    if (hasOld) {
+        m_deletionQueue.retire(std::move(texture.image), frame);
+    }
+    m_residentBytes -= getResidentSize(texture, texture.residentLevel);
+    m_residentBytes += getResidentSize(texture, residentLevel);
+    texture.image = std::move(image);
+    texture.view = std::move(view);
+    texture.residentLevel = residentLevel;
+    texture.generation++;
+}
+
+void TextureStreamer::collect(uint64_t completedFrame) {
+    m_deletionQueue.collect(completedFrame);
+}
+
+void TextureStreamer::rebind(vk::Image image) {
+    for (const auto& texture : m_textures) {
+        if (!texture || !texture->view || texture->image.getImage() != image) {
+            continue;
+        }
+        vk::ImageViewCreateInfo imageViewCreateInfo{};
+        imageViewCreateInfo.setImage(image);
+        imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+        imageViewCreateInfo.setFormat(texture->source->format);
+        imageViewCreateInfo.setSubresourceRange(vk::ImageSubresourceRange(
+            vk::ImageAspectFlagBits::eColor, 0,
+            texture->source->mipLevels - texture->residentLevel, 0, 1));
+        texture->view = m_device.getDevice().createImageView(imageViewCreateInfo);
+        texture->generation++;
+    }
+}
+
+TextureStreamer::Texture& TextureStreamer::getTexture(TextureId id) const {
+    if (id >= m_textures.size() || !m_textures[id]) {
+        LOG4CPLUS_ERROR(m_logger, std::format("Unknown texture {}", id));
+        throw std::runtime_error("Unknown texture");
+    }
+    return *m_textures[id];
+}
+
+vk::DeviceSize TextureStreamer::getResidentSize(const Texture& texture,
+                                                uint32_t residentLevel) const {
+    vk::DeviceSize size = 0;
+    for (uint32_t level = residentLevel; level < texture.source->mipLevels;
+         level++) {
+        size += getLevelSize(texture.source->format, texture.source->extent,
+                             level);
+    }
+    return size;
+}
+
+bool TextureStreamer::isResident(TextureId id) const {
+    const auto& texture = getTexture(id);
+    return texture.residentLevel < texture.source->mipLevels;
+}
+
+vk::ImageView TextureStreamer::getImageView(TextureId id) const {
+    const auto& texture = getTexture(id);
+    return texture.view ? **texture.view : vk::ImageView{};
+}
+
+uint32_t TextureStreamer::getResidentLevel(TextureId id) const {
+    return getTexture(id).residentLevel;
+}
+
+uint64_t TextureStreamer::getGeneration(TextureId id) const {
+    return getTexture(id).generation;
+}
+
+const vk::raii::Sampler& TextureStreamer::getSampler() const noexcept {
+    return m_sampler;
+}
+
+TextureStreamer::Statistics TextureStreamer::getStatistics() const noexcept {
+    Statistics statistics;
+    statistics.residentBytes = m_residentBytes;
+    statistics.budget = m_budget;
+    statistics.uploadedBytes = m_uploadedBytes;
+    statistics.evictions = m_evictions;
+    for (const auto& texture : m_textures) {
+        if (texture) {
+            statistics.textures++;
+            statistics.loading += texture->loading;
+        }
+    }
+    return statistics;
+}
+
+vk::DeviceSize TextureStreamer::getLevelSize(vk::Format format,
+                                             vk::Extent2D extent,
+                                             uint32_t level) {
+    auto block = getTexelBlock(format);
+    if (block.size == 0) {
+        return 0;
+    }
+    auto levelExtent = getLevelExtent(extent, level);
+    vk::DeviceSize columns = (levelExtent.width + block.size - 1) / block.size;
+    vk::DeviceSize rows = (levelExtent.height + block.size - 1) / block.size;
+    return columns * rows * block.bytes;
+}
+} // namespace compound
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "allocator.hpp"
+#include "deletionqueue.hpp"
+#include "jobsystem.hpp"
+#include <log4cplus/log4cplus.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace compound {
+// Texture to stream. loadLevel decodes (and transcodes, for block-compressed
+// formats) one mip level into tightly packed texel data; it runs on job
+// system workers and may be called concurrently for different textures.
+struct TextureSource {
+    vk::Format format = vk::Format::eR8G8B8A8Srgb;
+    vk::Extent2D extent;
+    uint32_t mipLevels = 1;
+    std::function<std::vector<std::byte>(uint32_t level)> loadLevel;
+};
+
+// Keeps a window of each texture's mip chain resident, from the smallest
+// level up to the finest one recently asked for, within a global byte budget.
+// A texture's image only holds its resident levels, so its view (and any
+// sampler used with it) is clamped to them; raising or lowering residency
+// reallocates the image, copies the levels already resident on the GPU and
+// retires the old image once the frames using it completed.
+//
+// Apart from the decode jobs, everything runs on the render thread.
+class TextureStreamer {
+public:
+    using TextureId = uint32_t;
+    struct Statistics {
+        vk::DeviceSize residentBytes = 0;
+        vk::DeviceSize budget = 0;
+        uint32_t textures = 0;
+        uint32_t loading = 0;
+        uint64_t uploadedBytes = 0;
+        uint64_t evictions = 0;
+    };
+
+    // Levels no larger than this are loaded when a texture is added.
+    static constexpr uint32_t kInitialSize = 32;
+    // Frames without a request before a texture falls back to its tail.
+    static constexpr uint64_t kIdleFrames = 120;
+
+    TextureStreamer(const Device& device, Allocator& allocator,
+                    vk::DeviceSize budget);
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+    ~TextureStreamer();
+
+    TextureId add(TextureSource source);
+    void remove(TextureId id, uint64_t lastUsed);
+    // Usage feedback: the texture was needed down to the given level this
+    // frame. Requests are kept until the next one or until kIdleFrames pass.
+    void request(TextureId id, uint32_t level, uint64_t frame);
+    // Level matching a texture covering the given number of pixels along its
+    // largest dimension on screen.
+    static uint32_t levelForCoverage(vk::Extent2D extent, float pixels);
+
+    void setBudget(vk::DeviceSize budget) noexcept;
+    void setUploadBudget(vk::DeviceSize bytesPerFrame) noexcept;
+    // Applies finished loads, evicts or raises residency and schedules new
+    // loads. Records transfers, so call it outside a render pass.
+    void record(const vk::raii::CommandBuffer& buffer, uint64_t frame);
+    // Frees images and staging buffers of frames up to completedFrame.
+    void collect(uint64_t completedFrame);
+    // Recreates the view of the texture whose image was moved to image, when
+    // the GPU no longer uses the previous one.
+    void rebind(vk::Image image);
+
+    bool isResident(TextureId id) const;
+    vk::ImageView getImageView(TextureId id) const;
+    // Finest resident level of the texture's full chain, the view's level 0.
+    uint32_t getResidentLevel(TextureId id) const;
+    // Changes whenever the texture's view does, so descriptors can be
+    // rewritten only when needed.
+    uint64_t getGeneration(TextureId id) const;
+    const vk::raii::Sampler& getSampler() const noexcept;
+    Statistics getStatistics() const noexcept;
+
+    static vk::DeviceSize getLevelSize(vk::Format format, vk::Extent2D extent,
+                                       uint32_t level);
+
+private:
+    struct Texture {
+        std::shared_ptr<const TextureSource> source;
+        Image image;
+        std::optional<vk::raii::ImageView> view;
+        // Levels [residentLevel, mipLevels) are in image; equal to mipLevels
+        // while nothing is resident.
+        uint32_t residentLevel = 0;
+        uint32_t tailLevel = 0;
+        uint32_t requestedLevel = 0;
+        uint64_t lastRequested = 0;
+        uint64_t generation = 0;
+        bool loading = false;
+        bool failed = false;
+    };
+    // Levels [level, level + levels.size()) of a texture, empty on failure.
+    struct Load {
+        TextureId id;
+        uint32_t level;
+        std::shared_ptr<const TextureSource> source;
+        std::vector<std::vector<std::byte>> levels;
+    };
+
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.texturestreamer");
+    const Device& m_device;
+    Allocator& m_allocator;
+    vk::raii::Sampler m_sampler;
+    std::vector<std::unique_ptr<Texture>> m_textures;
+    std::vector<TextureId> m_freeIds;
+    vk::DeviceSize m_budget;
+    vk::DeviceSize m_uploadBudget = 16 * 1024 * 1024;
+    vk::DeviceSize m_residentBytes = 0;
+    uint64_t m_uploadedBytes = 0;
+    uint64_t m_evictions = 0;
+    DeletionQueue m_deletionQueue;
+    std::mutex m_mutex;
+    std::vector<Load> m_finished;
+    std::atomic<bool> m_stopping = false;
+    JobSystem::Counter m_loading = 0;
+
+    Texture& getTexture(TextureId id) const;
+    vk::DeviceSize getResidentSize(const Texture& texture,
+                                   uint32_t residentLevel) const;
+    void schedule(TextureId id, uint32_t level);
+    void reallocate(const vk::raii::CommandBuffer& buffer, Texture& texture,
+                    uint32_t residentLevel, const Load* load, uint64_t frame);
+};
+} // namespace compound
@@ -0,0 +1,236 @@
+#include "transformhierarchy.hpp"
+
+#include "jobsystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <type_traits>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace compound {
+namespace {
+// out = a * b for column-major matrices; out may not alias a or b.
+void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+    const float* lhs = &a[0][0];
+    const float* rhs = &b[0][0];
+    float* result = &out[0][0];
+#if defined(__AVX__)
+    // Two result columns per register: shuffling within each 128-bit lane
+    // broadcasts b[j][k] in the low half and b[j + 1][k] in the high half.
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 12));
+    for (int j = 0; j < 16; j += 8) {
+        __m256 columns = _mm256_loadu_ps(rhs + j);
+        __m256 sum = _mm256_mul_ps(
+            a0, _mm256_shuffle_ps(columns, columns, _MM_SHUFFLE(0, 0, 0, 0)));
+        sum = _mm256_add_ps(
+            sum, _mm256_mul_ps(a1, _mm256_shuffle_ps(columns, columns,
+                                                     _MM_SHUFFLE(1, 1, 1, 1))));
+        sum = _mm256_add_ps(
+            sum, _mm256_mul_ps(a2, _mm256_shuffle_ps(columns, columns,
+                                                     _MM_SHUFFLE(2, 2, 2, 2))));
+        sum = _mm256_add_ps(
+            sum, _mm256_mul_ps(a3, _mm256_shuffle_ps(columns, columns,
+                                                     _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(result + j, sum);
+    }
+#elif defined(__SSE2__)
+    __m128 a0 = _mm_loadu_ps(lhs);
+    __m128 a1 = _mm_loadu_ps(lhs + 4);
+    __m128 a2 = _mm_loadu_ps(lhs + 8);
+    __m128 a3 = _mm_loadu_ps(lhs + 12);
+    for (int j = 0; j < 16; j += 4) {
+        __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(rhs[j]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(rhs[j + 1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(rhs[j + 2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(rhs[j + 3])));
+        _mm_storeu_ps(result + j, sum);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+glm::mat4 compose(const glm::vec3& position, const glm::quat& rotation,
+                  const glm::vec3& scale) {
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f),
+                     glm::vec4(r[1] * scale.y, 0.0f),
+                     glm::vec4(r[2] * scale.z, 0.0f),
+                     glm::vec4(position, 1.0f));
+}
+} // namespace
+
+TransformHierarchy::NodeId TransformHierarchy::addNode(NodeId parent) {
+    return addNode(parent, Transform{});
+}
+
+TransformHierarchy::NodeId TransformHierarchy::addNode(NodeId parent,
+                                                       const Transform& local) {
+    uint32_t depth = 0;
+    uint32_t parentIndex = kNoParent;
+    if (parent != kNoParent) {
+        if (parent >= m_indices.size()) {
+            LOG4CPLUS_ERROR(m_logger, "Invalid parent node");
+            throw std::runtime_error("Invalid parent node");
+        }
+        parentIndex = m_indices[parent];
+        depth = m_depths[parentIndex] + 1;
+    }
+    NodeId id = static_cast<NodeId>(m_ids.size());
+    if (!m_depths.empty() && depth < m_depths.back()) {
+        m_sorted = false;
+    }
+    m_indices.push_back(static_cast<uint32_t>(m_ids.size()));
+    m_ids.push_back(id);
+    m_parents.push_back(parentIndex);
+    m_depths.push_back(depth);
+    m_positions.push_back(local.position);
+    m_rotations.push_back(local.rotation);
+    m_scales.push_back(local.scale);
+    m_world.emplace_back(1.0f);
+    m_dirty.push_back(1);
+    if (m_sorted) {
+        if (depth + 1 >= m_levels.size()) {
+            m_levels.push_back(static_cast<uint32_t>(m_ids.size()));
+        } else {
+            m_levels.back() = static_cast<uint32_t>(m_ids.size());
+        }
+    }
+    return id;
+}
+
+void TransformHierarchy::setLocal(NodeId node, const Transform& local) {
+    uint32_t index = m_indices[node];
+    m_positions[index] = local.position;
+    m_rotations[index] = local.rotation;
+    m_scales[index] = local.scale;
+    m_dirty[index] = 1;
+}
+
+TransformHierarchy::Transform TransformHierarchy::getLocal(NodeId node) const {
+    uint32_t index = m_indices[node];
+    return {m_positions[index], m_rotations[index], m_scales[index]};
+}
+
+const glm::mat4& TransformHierarchy::getWorld(NodeId node) const {
+    return m_world[m_indices[node]];
+}
+
+TransformHierarchy::NodeId TransformHierarchy::getParent(NodeId node) const {
+    uint32_t parent = m_parents[m_indices[node]];
+    return parent == kNoParent ? kNoParent : m_ids[parent];
+}
+
+void TransformHierarchy::sort() {
+    // Counting sort by depth, stable so siblings keep their relative order.
+    size_t count = m_ids.size();
+    uint32_t maxDepth = *std::max_element(m_depths.begin(), m_depths.end());
+    m_levels.assign(maxDepth + 2, 0);
+    for (uint32_t depth : m_depths) {
+        m_levels[depth + 1]++;
+    }
+    for (size_t i = 1; i < m_levels.size(); i++) {
+        m_levels[i] += m_levels[i - 1];
+    }
+    std::vector<uint32_t> order(count);
+    std::vector<uint32_t> next(m_levels.begin(), m_levels.end() - 1);
+    for (size_t i = 0; i < count; i++) {
+        order[next[m_depths[i]]++] = static_cast<uint32_t>(i);
+    }
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(count);
+        for (size_t i = 0; i < count; i++) {
+            sorted[i] = values[order[i]];
+        }
+        values.swap(sorted);
+    };
+    std::vector<uint32_t> newIndex(count);
+    for (size_t i = 0; i < count; i++) {
+        newIndex[order[i]] = static_cast<uint32_t>(i);
+    }
+    for (auto& parent : m_parents) {
+        if (parent != kNoParent) {
+            parent = newIndex[parent];
+        }
+    }
+    permute(m_ids);
+    permute(m_parents);
+    permute(m_depths);
+    permute(m_positions);
+    permute(m_rotations);
+    permute(m_scales);
+    permute(m_world);
+    permute(m_dirty);
+    for (size_t i = 0; i < count; i++) {
+        m_indices[m_ids[i]] = static_cast<uint32_t>(i);
+    }
+    m_sorted = true;
+}
+
+size_t TransformHierarchy::updateRange(size_t begin, size_t end) {
+    size_t updated = 0;
+    for (size_t i = begin; i < end; i++) {
+        uint32_t parent = m_parents[i];
+        if (parent != kNoParent) {
+            // The parent's level is complete, its flag is final.
+            m_dirty[i] |= m_dirty[parent];
+        }
+        if (m_dirty[i] == 0) {
+            continue;
+        }
+        glm::mat4 local = compose(m_positions[i], m_rotations[i], m_scales[i]);
+        if (parent == kNoParent) {
+            m_world[i] = local;
+        } else {
+            multiply(m_world[parent], local, m_world[i]);
+        }
+        updated++;
+    }
+    return updated;
+}
+
+void TransformHierarchy::update(bool parallel) {
+    if (!m_sorted) {
+        sort();
+    }
+    std::atomic<size_t> updated = 0;
+    for (size_t level = 0; level + 1 < m_levels.size(); level++) {
+        size_t begin = m_levels[level];
+        size_t end = m_levels[level + 1];
+        if (!parallel || end - begin <= kGrainSize) {
+            updated += updateRange(begin, end);
+            continue;
+        }
+        JobSystem::get().parallelFor(
+            end - begin, kGrainSize, [&](size_t first, size_t last) {
+                updated += updateRange(begin + first, begin + last);
+            });
+    }
+    std::fill(m_dirty.begin(), m_dirty.end(), 0);
+    m_statistics = {m_ids.size(), updated.load(), m_levels.size() - 1};
+}
+
+size_t TransformHierarchy::size() const noexcept {
+    return m_ids.size();
+}
+
+std::span<const glm::mat4> TransformHierarchy::getWorldMatrices()
+    const noexcept {
+    return m_world;
+}
+
+std::span<const TransformHierarchy::NodeId> TransformHierarchy::getNodeIds()
+    const noexcept {
+    return m_ids;
+}
+
+const TransformHierarchy::Statistics& TransformHierarchy::getStatistics()
+    const noexcept {
+    return m_statistics;
+}
+} // namespace compound
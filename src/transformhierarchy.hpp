@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <log4cplus/log4cplus.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace compound {
+// Scene node transforms stored as structure of arrays, ordered by depth so
+// every parent precedes its children and each depth level is a contiguous
+// range. update() recomputes world matrices only for nodes whose local
+// transform, or an ancestor's, changed since the last update, in one linear
+// sweep per level. Levels large enough are split across the job system.
+//
+// Node ids are stable; the storage order is not, since adding a node above
+// the deepest level reorders the arrays on the next update.
+class TransformHierarchy {
+public:
+    using NodeId = uint32_t;
+    static constexpr NodeId kNoParent = UINT32_MAX;
+    struct Transform {
+        glm::vec3 position{0.0f};
+        glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+        glm::vec3 scale{1.0f};
+    };
+    struct Statistics {
+        size_t nodes = 0;
+        size_t updated = 0;
+        size_t levels = 0;
+    };
+
+    NodeId addNode(NodeId parent = kNoParent);
+    NodeId addNode(NodeId parent, const Transform& local);
+    void setLocal(NodeId node, const Transform& local);
+    Transform getLocal(NodeId node) const;
+    const glm::mat4& getWorld(NodeId node) const;
+    NodeId getParent(NodeId node) const;
+    void update(bool parallel = true);
+    size_t size() const noexcept;
+    // World matrices in storage order, valid until the next update().
+    std::span<const glm::mat4> getWorldMatrices() const noexcept;
+    std::span<const NodeId> getNodeIds() const noexcept;
+    const Statistics& getStatistics() const noexcept;
+
+private:
+    static constexpr size_t kGrainSize = 4096;
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.transformhierarchy");
+    // Indexed by id.
+    std::vector<uint32_t> m_indices;
+    // Indexed by storage position.
+    std::vector<NodeId> m_ids;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_depths;
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::quat> m_rotations;
+    std::vector<glm::vec3> m_scales;
+    std::vector<glm::mat4> m_world;
+    std::vector<uint8_t> m_dirty;
+    // Start of each depth level, plus the end of the last one.
+    std::vector<uint32_t> m_levels = {0};
+    bool m_sorted = true;
+    Statistics m_statistics;
+    void sort();
+    size_t updateRange(size_t begin, size_t end);
+};
+} // namespace compound
@@ -0,0 +1,132 @@
+#include "transientattachments.hpp"
+
+#include <log4cplus/loggingmacros.h>
+#include <format>
+
+namespace compound {
+TransientAttachments::TransientAttachments(const Device& device,
+                                           Allocator& allocator,
+                                           const RenderPassState& renderPass,
+                                           const vk::Extent2D& extent)
+    : m_device(device),
+      m_allocator(allocator),
+      m_renderPass(renderPass),
+      m_extent(extent),
+      m_lazilyAllocated(device.supportsLazilyAllocatedMemory()) {
+    LOG4CPLUS_INFO(m_logger,
+                   std::format("Creating transient attachments, {} memory",
+                               m_lazilyAllocated ? "lazily allocated"
+                                                 : "device local"));
+    create();
+}
+
+bool TransientAttachments::resize(const vk::Extent2D& extent,
+                                  DeletionQueue& deletionQueue,
+                                  uint64_t lastUsed) {
+    if (extent == m_extent) {
+        return false;
+    }
+    LOG4CPLUS_DEBUG(m_logger, std::format("Resizing to {}x{}", extent.width,
+                                          extent.height));
+    deletionQueue.retire(std::move(m_attachments), lastUsed);
+    m_attachments.clear();
+    m_views.clear();
+    m_extent = extent;
+    create();
+    return true;
+}
+
+const std::vector<vk::ImageView>& TransientAttachments::getViews()
+    const noexcept {
+    return m_views;
+}
+
+const vk::Extent2D& TransientAttachments::getExtent() const noexcept {
+    return m_extent;
+}
+
+bool TransientAttachments::isLazilyAllocated() const noexcept {
+    return m_lazilyAllocated;
+}
+
+vk::Format TransientAttachments::selectDepthFormat(const Device& device) {
+    for (auto format : {vk::Format::eD32Sfloat, vk::Format::eX8D24UnormPack32,
+                        vk::Format::eD16Unorm}) {
+        auto features = device.getPhysicalDevice()
+                            .getFormatProperties(format)
+                            .optimalTilingFeatures;
+        if (features & vk::FormatFeatureFlagBits::eDepthStencilAttachment) {
+            return format;
+        }
+    }
+    LOG4CPLUS_ERROR(
+        log4cplus::Logger::getInstance("compound.transientattachments"),
+        "No supported depth attachment format");
+    throw std::runtime_error("No supported depth attachment format");
+}
+
+vk::SampleCountFlagBits TransientAttachments::selectSamples(
+    const Device& device, uint32_t maxSamples) {
+    const auto& limits = device.getProperties().limits;
+    auto supported = limits.framebufferColorSampleCounts &
+                     limits.framebufferDepthSampleCounts;
+    for (auto samples :
+         {vk::SampleCountFlagBits::e64, vk::SampleCountFlagBits::e32,
+          vk::SampleCountFlagBits::e16, vk::SampleCountFlagBits::e8,
+          vk::SampleCountFlagBits::e4, vk::SampleCountFlagBits::e2}) {
+        if (static_cast<uint32_t>(samples) <= maxSamples &&
+            (supported & samples)) {
+            return samples;
+        }
+    }
+    return vk::SampleCountFlagBits::e1;
+}
+
+void TransientAttachments::create() {
+    if (m_renderPass.samples != vk::SampleCountFlagBits::e1) {
+        createAttachment(m_renderPass.colorFormat,
+                         vk::ImageUsageFlagBits::eColorAttachment,
+                         vk::ImageAspectFlagBits::eColor);
+    }
+    if (m_renderPass.depthFormat != vk::Format::eUndefined) {
+        createAttachment(m_renderPass.depthFormat,
+                         vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                         vk::ImageAspectFlagBits::eDepth);
+    }
+}
+
+void TransientAttachments::createAttachment(vk::Format format,
+                                            vk::ImageUsageFlags usage,
+                                            vk::ImageAspectFlags aspect) {
+    vk::ImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.setImageType(vk::ImageType::e2D);
+    imageCreateInfo.setFormat(format);
+    imageCreateInfo.setExtent({m_extent.width, m_extent.height, 1});
+    imageCreateInfo.setMipLevels(1);
+    imageCreateInfo.setArrayLayers(1);
+    imageCreateInfo.setSamples(m_renderPass.samples);
+    imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+    // Transient limits the usage to attachments, which is what allows the
+    // lazily allocated memory types.
+    imageCreateInfo.setUsage(usage |
+                             vk::ImageUsageFlagBits::eTransientAttachment);
+    imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+    VmaAllocationCreateInfo allocationCreateInfo{};
+    allocationCreateInfo.usage = m_lazilyAllocated
+                                     ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED
+                                     : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+    Image image = m_allocator.createImage(imageCreateInfo, allocationCreateInfo,
+                                          MemoryCategory::eAttachment);
+
+    vk::ImageViewCreateInfo imageViewCreateInfo{};
+    imageViewCreateInfo.setImage(image.getImage());
+    imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+    imageViewCreateInfo.setFormat(format);
+    imageViewCreateInfo.setSubresourceRange(
+        vk::ImageSubresourceRange(aspect, 0, 1, 0, 1));
+    auto view = m_device.getDevice().createImageView(imageViewCreateInfo);
+    m_views.push_back(*view);
+    m_attachments.push_back({std::move(image), std::move(view)});
+}
+} // namespace compound
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include "device.hpp"
+#include "allocator.hpp"
+#include "deletionqueue.hpp"
+#include "pipelinestate.hpp"
+#include <log4cplus/log4cplus.h>
+#include <vector>
+
+namespace compound {
+// The multisampled color and depth images of a render pass, which only live
+// within the pass. They are created as transient attachments and, where the
+// device offers it, backed by lazily allocated memory, so that tiled GPUs can
+// keep them in tile memory without ever committing full-size backing.
+class TransientAttachments {
+public:
+    TransientAttachments(const Device& device, Allocator& allocator,
+                         const RenderPassState& renderPass,
+                         const vk::Extent2D& extent);
+    TransientAttachments(const TransientAttachments&) = delete;
+    TransientAttachments& operator=(const TransientAttachments&) = delete;
+    // Recreates the images when the extent changed, retiring the old ones
+    // until lastUsed completed. Framebuffers built on the previous views
+    // have to be recreated when this returns true.
+    bool resize(const vk::Extent2D& extent, DeletionQueue& deletionQueue,
+                uint64_t lastUsed);
+    // Views in framebuffer order, to follow the single-sampled color view.
+    const std::vector<vk::ImageView>& getViews() const noexcept;
+    const vk::Extent2D& getExtent() const noexcept;
+    bool isLazilyAllocated() const noexcept;
+    // First depth format usable as an attachment.
+    static vk::Format selectDepthFormat(const Device& device);
+    // Highest sample count up to maxSamples usable for color and depth.
+    static vk::SampleCountFlagBits selectSamples(const Device& device,
+                                                 uint32_t maxSamples);
+
+private:
+    struct Attachment {
+        Image image;
+        vk::raii::ImageView view;
+    };
+    log4cplus::Logger m_logger =
+        log4cplus::Logger::getInstance("compound.transientattachments");
+    const Device& m_device;
+    Allocator& m_allocator;
+    RenderPassState m_renderPass;
+    vk::Extent2D m_extent;
+    bool m_lazilyAllocated;
+    std::vector<Attachment> m_attachments;
+    std::vector<vk::ImageView> m_views;
+    void create();
+    void createAttachment(vk::Format format, vk::ImageUsageFlags usage,
+                          vk::ImageAspectFlags aspect);
+};
+} // namespace compound
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace compound {
+// Lock-free handoff of the latest value from one writer thread to one reader
+// thread. Neither side ever waits: the writer fills its private buffer and
+// publishes it, the reader picks up whatever was published last.
+template <typename T>
+class TripleBuffer {
+public:
+    T& getWriteBuffer() noexcept {
+        return m_buffers[m_write];
+    }
+
+    void publish() noexcept {
+        uint8_t previous =
+            m_middle.exchange(m_write | kDirty, std::memory_order_acq_rel);
+        m_write = previous & kIndexMask;
+    }
+
+    bool update() noexcept {
+        if ((m_middle.load(std::memory_order_relaxed) & kDirty) == 0) {
+            return false;
+        }
+        uint8_t previous =
+            m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & kIndexMask;
+        return true;
+    }
+
+    const T& getReadBuffer() const noexcept {
+        return m_buffers[m_read];
+    }
+
+private:
+    static constexpr uint8_t kDirty = 0x4;
+    static constexpr uint8_t kIndexMask = 0x3;
+    std::array<T, 3> m_buffers{};
+    alignas(64) uint8_t m_write = 0;
+    alignas(64) std::atomic<uint8_t> m_middle = 1;
+    alignas(64) uint8_t m_read = 2;
+};
+} // namespace compound
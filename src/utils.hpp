@@ -2,10 +2,11 @@
 
 #include <vector>
 #include <fstream>
+#include <functional>
 
 namespace compound {
 namespace utils {
-    std::vector<char> readFile(const std::string& path) {
+    inline std::vector<char> readFile(const std::string& path) {
         std::ifstream f(path, std::ios::ate | std::ios::binary);
         if (!f.good()) {
             throw std::runtime_error(path + "is invalid");
@@ -16,5 +17,10 @@ namespace utils {
         f.read(out.data(), size);
         return out;
     }
+
+    template <typename T>
+    inline void hashCombine(size_t& seed, const T& value) {
+        seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
 }
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include "window.hpp"
 
 namespace compound {
+namespace {
+Window* fromHandle(GLFWwindow* handle) {
+    return static_cast<Window*>(glfwGetWindowUserPointer(handle));
+}
+} // namespace
+
 Window::Window(const Init& init, int width, int height,
                const std::string& title)
     : m_width(width), m_height(height), m_surface(0) {
@@ -37,4 +43,41 @@ std::array<int, 2> Window::getFramebufferSize() const noexcept {
     glfwGetFramebufferSize(m_handle, &width, &height);
     return {width, height};
 }
+
+std::array<double, 2> Window::getCursorPosition() const noexcept {
+    double x, y;
+    glfwGetCursorPos(m_handle, &x, &y);
+    return {x, y};
+}
+
+void Window::pushEvent(const InputEvent& event) {
+    if (m_eventQueue != nullptr && !m_eventQueue->push(event)) {
+        LOG4CPLUS_WARN(m_logger, "Event queue full, dropping event");
+    }
+}
+
+void Window::setEventQueue(EventQueue* queue) {
+    m_eventQueue = queue;
+    glfwSetWindowUserPointer(m_handle, this);
+    using Type = InputEvent::Type;
+    glfwSetKeyCallback(m_handle, [](GLFWwindow* handle, int key, int,
+                                    int action, int mods) {
+        fromHandle(handle)->pushEvent({Type::eKey, key, action, mods});
+    });
+    glfwSetMouseButtonCallback(
+        m_handle, [](GLFWwindow* handle, int button, int action, int mods) {
+            fromHandle(handle)->pushEvent({Type::eMouseButton, button, action, mods});
+        });
+    glfwSetCursorPosCallback(m_handle,
+                             [](GLFWwindow* handle, double x, double y) {
+                                 fromHandle(handle)->pushEvent(
+                                     {Type::eCursor, 0, 0, 0, x, y});
+                             });
+    glfwSetScrollCallback(m_handle, [](GLFWwindow* handle, double x, double y) {
+        fromHandle(handle)->pushEvent({Type::eScroll, 0, 0, 0, x, y});
+    });
+    glfwSetWindowCloseCallback(m_handle, [](GLFWwindow* handle) {
+        fromHandle(handle)->pushEvent({Type::eClose});
+    });
+}
 } // namespace compound
\ No newline at end of file
@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include "init.hpp"
+#include "inputevent.hpp"
 #include <vulkan/vulkan_raii.hpp>
 #include <log4cplus/log4cplus.h>
 #include <array>
@@ -15,11 +16,17 @@ private:
     int m_height;
     GLFWwindow* m_handle;
     vk::raii::SurfaceKHR m_surface;
+    EventQueue* m_eventQueue = nullptr;
+    void pushEvent(const InputEvent& event);
 public:
     Window(const Init& init, int width, int height, const std::string& title);
     ~Window();
     GLFWwindow* getHandle() const noexcept;
     const vk::raii::SurfaceKHR& getSurface() const noexcept;
     std::array<int, 2> getFramebufferSize() const noexcept;
+    std::array<double, 2> getCursorPosition() const noexcept;
+    // Forwards input from the GLFW callbacks into the queue. Callbacks only
+    // fire on the main thread, inside glfwPollEvents and friends.
+    void setEventQueue(EventQueue* queue);
 };
 }
\ No newline at end of file
@@ -1,37 +1,289 @@
-#include <iostream>
 #include "init.hpp"
 #include <log4cplus/configurator.h>
+#include <log4cplus/loggingmacros.h>
 #include "device.hpp"
+#include "allocator.hpp"
 #include "window.hpp"
 #include "swapchain.hpp"
 #include "pipeline.hpp"
+#include "pipelinereloader.hpp"
+#include "pipelinecache.hpp"
 #include "framebuffer.hpp"
 #include "commandstructs.hpp"
 #include "renderloop.hpp"
+#include "overlay.hpp"
+#include "dynamicresolution.hpp"
+#include "framecapture.hpp"
+#include "pipelinestatistics.hpp"
+#include "renderthread.hpp"
+#include "startup.hpp"
+#include "defragmenter.hpp"
+#include "texturestreamer.hpp"
+#include "transientattachments.hpp"
+#include "occlusionqueries.hpp"
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <list>
+#include <mutex>
+#include <optional>
 
 int main() {
     log4cplus::BasicConfigurator::doConfigure();
+    compound::Startup startup;
     compound::Init::setAppName("compound-test");
     const compound::Init& init = compound::Init::get();
-    compound::Window window(init, 800, 450, "test");
-    compound::Device device(init, window.getSurface());
-    compound::Swapchain swapchain(device, window);
-    compound::Pipeline pipeline(
-        device, std::string(TEST_DIR) + "shaders/basic.vert.spv",
-        std::string(TEST_DIR) + "shaders/basic.frag.spv",
-        swapchain.getFormat());
-    auto framebuffers = compound::Framebuffer::create(
-        device, swapchain.getImageViews(), swapchain.getExtent(),
-        pipeline.getRenderpass());
-    compound::CommandPool graphicsCommandPool(
-        device, device.getGraphicsFamilyQueueIndex());
-    compound::CommandBuffer graphicsCommandBuffer(device, graphicsCommandPool);
-    compound::Renderloop renderloop(device, framebuffers);
-    while (!glfwWindowShouldClose(window.getHandle())) {
-        glfwPollEvents();
-        renderloop.drawFrame(device, framebuffers, graphicsCommandBuffer,
-                             swapchain, pipeline);
+    // Physical devices are probed while GLFW, which must stay on the main
+    // thread, opens the window.
+    auto probe = startup.launch("probe physical devices",
+                                [&] { init.getPhysicalDevices(); });
+    std::optional<compound::Window> window;
+    startup.run("window", [&] { window.emplace(init, 800, 450, "test"); });
+    probe.get();
+    std::optional<compound::Device> device;
+    startup.run("device", [&] { device.emplace(init, window->getSurface()); });
+    std::optional<compound::Allocator> allocator;
+    startup.run("allocator", [&] {
+        allocator.emplace(init, *device);
+        allocator->addBudgetCallback(
+            0.9f, [](const compound::Allocator::HeapBudget& budget,
+                     bool exceeded) {
+                LOG4CPLUS_WARN(
+                    log4cplus::Logger::getInstance("compound.test"),
+                    std::format("Heap {} {} 90% of its budget : {} / {}",
+                                budget.heap,
+                                exceeded ? "crossed" : "dropped below",
+                                budget.usage, budget.budget));
+            });
+    });
+    std::optional<compound::Swapchain> swapchain;
+    // Depth tested and 4x antialiased, resolved within the main pass.
+    compound::RenderPassState mainPass{};
+    startup.run("swapchain", [&] {
+        swapchain.emplace(*device, *window);
+        mainPass.colorFormat = swapchain->getFormat();
+        mainPass.depthFormat =
+            compound::TransientAttachments::selectDepthFormat(*device);
+        mainPass.samples =
+            compound::TransientAttachments::selectSamples(*device, 4);
+    });
+    // Shader modules and the pipeline build in the background while the
+    // remaining per-swapchain resources are created here.
+    std::optional<compound::PipelineReloader> pipelineReloader;
+    auto pipeline = startup.launch("pipeline", [&] {
+        pipelineReloader.emplace(
+            *device, std::string(TEST_DIR) + "shaders/basic.vert.spv",
+            std::string(TEST_DIR) + "shaders/basic.frag.spv", mainPass);
+        pipelineReloader->watchGlsl(
+            std::string(TEST_DIR) + "shaders/basic.vert",
+            std::string(TEST_DIR) + "shaders/basic.vert.spv");
+        pipelineReloader->watchGlsl(
+            std::string(TEST_DIR) + "shaders/basic.frag",
+            std::string(TEST_DIR) + "shaders/basic.frag.spv");
+    });
+    std::optional<compound::CommandPool> graphicsCommandPool;
+    std::optional<compound::CommandBuffer> graphicsCommandBuffer;
+    startup.run("command buffers", [&] {
+        graphicsCommandPool.emplace(*device,
+                                    device->getGraphicsFamilyQueueIndex());
+        graphicsCommandBuffer.emplace(*device, *graphicsCommandPool);
+    });
+    std::optional<compound::Overlay> overlay;
+    startup.run("overlay", [&] { overlay.emplace(init, *device, *swapchain); });
+    std::optional<compound::DynamicResolution> dynamicResolution;
+    std::optional<compound::PipelineStatistics> pipelineStatistics;
+    std::optional<compound::FrameCapture> frameCapture;
+    std::optional<compound::TextureStreamer> textureStreamer;
+    std::optional<compound::Defragmenter> defragmenter;
+    std::optional<compound::OcclusionQueries> occlusionQueries;
+    std::optional<compound::PipelineCache> pipelineCache;
+    compound::PipelineState proxyState;
+    compound::TextureStreamer::TextureId checker = 0;
+    startup.run("frame resources", [&] {
+        dynamicResolution.emplace(*device, *allocator, *swapchain, mainPass);
+        pipelineStatistics.emplace(*device);
+        frameCapture.emplace(*device, *allocator, *swapchain,
+                             compound::FrameCapture::ppmSequence("capture"));
+        textureStreamer.emplace(*device, *allocator, 64 * 1024 * 1024);
+        checker = textureStreamer->add(
+            {vk::Format::eR8G8B8A8Unorm, {1024, 1024}, 11, [](uint32_t level) {
+                 uint32_t size = std::max(1024u >> level, 1u);
+                 std::vector<std::byte> pixels(size * size * 4);
+                 for (uint32_t i = 0; i < size * size; i++) {
+                     bool white = ((i % size) / 8 + (i / size) / 8) % 2;
+                     auto value = std::byte(white ? 255 : 32);
+                     pixels[i * 4] = pixels[i * 4 + 1] = pixels[i * 4 + 2] =
+                         value;
+                     pixels[i * 4 + 3] = std::byte(255);
+                 }
+                 return pixels;
+             }});
+        defragmenter.emplace(*device, *allocator);
+        defragmenter->addListener(
+            [&](const compound::Defragmenter::Relocation& relocation) {
+                if (relocation.newImage) {
+                    textureStreamer->rebind(relocation.newImage);
+                }
+            });
+        occlusionQueries.emplace(*device, *allocator, 1);
+        pipelineCache.emplace(*device);
+        proxyState = compound::OcclusionQueries::createProxyState(
+            std::string(TEST_DIR) + "shaders/box.vert.spv",
+            std::string(TEST_DIR) + "shaders/box.frag.spv", mainPass);
+        pipelineCache->getPipeline(proxyState);
+    });
+    pipeline.get();
+    std::optional<compound::TransientAttachments> attachments;
+    std::vector<compound::Framebuffer> framebuffers;
+    std::optional<compound::Renderloop> renderloop;
+    startup.run("framebuffers", [&] {
+        attachments.emplace(*device, *allocator, mainPass,
+                            swapchain->getExtent());
+        framebuffers = compound::Framebuffer::create(
+            *device, swapchain->getImageViews(), swapchain->getExtent(),
+            pipelineReloader->getPipeline().getRenderpass(),
+            attachments->getViews());
+        renderloop.emplace(*device, framebuffers);
+    });
+    // Further windows, opened with F2. The main thread creates and destroys
+    // their windows and swapchains, the render thread adds and removes them
+    // as render targets.
+    struct Screen {
+        std::optional<compound::Window> window;
+        std::optional<compound::Swapchain> swapchain;
+        std::optional<compound::TransientAttachments> attachments;
+        std::vector<compound::Framebuffer> framebuffers;
+        std::optional<compound::Renderloop::TargetId> target;
+        std::optional<uint64_t> removedAt;
+        bool closing = false;
+        bool released = false;
+    };
+    std::mutex screensMutex;
+    std::list<Screen> screens;
+    std::atomic<bool> openScreen = false;
+    bool firstFrame = true;
+    compound::RenderThread renderThread(
+        [&](const compound::InputEvent& event) {
+            if (event.type == compound::InputEvent::Type::eKey &&
+                event.code == GLFW_KEY_F1 && event.action == GLFW_PRESS) {
+                overlay->setVisible(!overlay->isVisible());
+            }
+            if (event.type == compound::InputEvent::Type::eKey &&
+                event.code == GLFW_KEY_F12 && event.action == GLFW_PRESS) {
+                frameCapture->setCapturing(!frameCapture->isCapturing());
+            }
+            if (event.type == compound::InputEvent::Type::eKey &&
+                event.code == GLFW_KEY_F2 && event.action == GLFW_PRESS) {
+                openScreen = true;
+            }
+        },
+        [&](const compound::FrameInput&) {
+            allocator->checkBudget(renderloop->getCurrentFrame());
+            pipelineReloader->update(renderloop->getDeletionQueue(),
+                                     renderloop->getCurrentFrame());
+            // Swaps fast-linked variants for their optimized builds.
+            pipelineCache->promote(renderloop->getDeletionQueue(),
+                                   renderloop->getCurrentFrame());
+            overlay->update(renderloop->getTimings(),
+                            graphicsCommandBuffer->getStatistics(),
+                            &*allocator, &*pipelineStatistics);
+            dynamicResolution->update(renderloop->getTimings());
+            textureStreamer->request(checker, 0, renderloop->getCurrentFrame());
+            // Follows the swapchain extent once the swapchain is recreated.
+            if (attachments->resize(swapchain->getExtent(),
+                                    renderloop->getDeletionQueue(),
+                                    renderloop->getCurrentFrame())) {
+                renderloop->getDeletionQueue().retire(
+                    std::move(framebuffers), renderloop->getCurrentFrame());
+                framebuffers = compound::Framebuffer::create(
+                    *device, swapchain->getImageViews(), swapchain->getExtent(),
+                    pipelineReloader->getPipeline().getRenderpass(),
+                    attachments->getViews());
+            }
+            {
+                std::lock_guard lock(screensMutex);
+                for (auto& screen : screens) {
+                    if (!screen.closing) {
+                        if (!screen.target) {
+                            screen.attachments.emplace(
+                                *device, *allocator, mainPass,
+                                screen.swapchain->getExtent());
+                            screen.framebuffers = compound::Framebuffer::create(
+                                *device, screen.swapchain->getImageViews(),
+                                screen.swapchain->getExtent(),
+                                pipelineReloader->getPipeline().getRenderpass(),
+                                screen.attachments->getViews());
+                            screen.target = renderloop->addTarget(
+                                *device, *screen.swapchain, screen.framebuffers);
+                        }
+                    } else if (screen.target) {
+                        screen.removedAt =
+                            renderloop->removeTarget(*screen.target);
+                        screen.target.reset();
+                    } else if (!screen.removedAt ||
+                               renderloop->getCompletedFrame() >=
+                                   *screen.removedAt) {
+                        screen.released = true;
+                    }
+                }
+            }
+            // The triangle is drawn in clip space, its box is the quad
+            // around it.
+            compound::OcclusionRecord occlusion{
+                .queries = &*occlusionQueries,
+                .proxyPipeline = pipelineCache->getPipeline(proxyState),
+                .proxyLayout =
+                    pipelineCache->getPipelineLayout(proxyState.layout),
+                .box = {{-0.5f, -0.5f, 0.0f}, {0.5f, 0.5f, 0.0f}}};
+            renderloop->drawFrame(*device, framebuffers,
+                                  *graphicsCommandBuffer, *swapchain,
+                                  pipelineReloader->getPipeline(),
+                                  {.overlay = &*overlay,
+                                   .dynamicResolution = &*dynamicResolution,
+                                   .capture = &*frameCapture,
+                                   .pipelineStatistics = &*pipelineStatistics,
+                                   .textures = &*textureStreamer,
+                                   .defragmenter = &*defragmenter,
+                                   .occlusion = &occlusion});
+            if (firstFrame) {
+                firstFrame = false;
+                startup.report();
+            }
+        });
+    window->setEventQueue(&renderThread.getEventQueue());
+    renderThread.start();
+    uint64_t sequence = 0;
+    while (!glfwWindowShouldClose(window->getHandle()) &&
+           renderThread.isRunning()) {
+        glfwWaitEventsTimeout(0.01);
+        if (openScreen.exchange(false)) {
+            std::list<Screen> opened;
+            auto& screen = opened.emplace_back();
+            screen.window.emplace(init, 640, 360, "test screen");
+            screen.swapchain.emplace(*device, *screen.window);
+            std::lock_guard lock(screensMutex);
+            screens.splice(screens.end(), opened);
+        }
+        {
+            std::lock_guard lock(screensMutex);
+            for (auto& screen : screens) {
+                if (glfwWindowShouldClose(screen.window->getHandle())) {
+                    screen.closing = true;
+                }
+            }
+            screens.remove_if(
+                [](const Screen& screen) { return screen.released; });
+        }
+        auto& input = renderThread.getFrameInput().getWriteBuffer();
+        auto [cursorX, cursorY] = window->getCursorPosition();
+        auto [width, height] = window->getFramebufferSize();
+        input = {++sequence, cursorX, cursorY, width, height};
+        renderThread.getFrameInput().publish();
     }
-    device.getDevice().waitIdle();
+    renderThread.stop();
+    window->setEventQueue(nullptr);
+    renderThread.rethrowIfFailed();
+    renderloop->waitIdle();
+    device->getDevice().waitIdle();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 450
+
+// Unit cube as 12 triangles, corner index bits are x, y and z.
+const uint corners[36] = uint[](
+    0, 2, 1, 1, 2, 3,
+    4, 5, 6, 5, 7, 6,
+    0, 1, 4, 1, 5, 4,
+    2, 6, 3, 3, 6, 7,
+    0, 4, 2, 2, 4, 6,
+    1, 3, 5, 3, 7, 5
+);
+
+layout(push_constant) uniform Box {
+    mat4 boxToClip;
+} box;
+
+void main() {
+    uint corner = corners[gl_VertexIndex];
+    vec3 position = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u);
+    gl_Position = box.boxToClip * vec4(position, 1.0);
+}
\ No newline at end of file